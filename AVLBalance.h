@@ -0,0 +1,214 @@
+//
+//  AVLBalance.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__AVLBalance__
+#define __Tree_exercises__AVLBalance__
+
+#include <iostream>
+
+#include "TreeNode.h"
+#include "BinaryTree.h"
+
+/**
+ AVL balance policy for BinaryTree, e.g. BinaryTree<StringNode, AVLBalance>.
+ 
+ Every node keeps the height of its subtree in balanceInfo (a leaf is 1), and the
+ heights of a node's two subtrees differ by at most one.  That keeps the tree within
+ about 1.44 log2(n) levels, against red-black's 2 log2(n), so lookups are a little
+ shorter; the price is that erases can rotate all the way up to the root.
+ 
+ After a change, walk up from where it happened fixing heights, and rotate any node
+ whose subtrees are two apart.  Once a subtree's height comes out the same as it
+ was, nothing above it can have changed, so stop there.  See RedBlackBalance.h for
+ what a balance policy provides.
+ **/
+class AVLBalance
+{
+public:
+    template <typename TreeT, typename NodeT>
+    void linkRoot(TreeT &tree, NodeT *root)
+    {
+        root->balanceInfo = 1;
+    }
+    
+    template <typename TreeT, typename NodeT>
+    unsigned int afterInsert(TreeT &tree, NodeT *node)
+    {
+        node->balanceInfo = 1;
+        
+        unsigned int levels = retrace(tree, nodeCast<NodeT>(node->parentNode));
+        treeCount(tree.counters.insertFixupLevels += levels);
+        
+        return levels;
+    }
+    
+    template <typename TreeT, typename NodeT>
+    void beforeErase(TreeT &tree, NodeT *node)
+    {
+        
+    }
+    
+    /// The successor (if one moved) took over the removed node's height, and the
+    /// heights are all still right above parent, so that's where to start
+    template <typename TreeT, typename NodeT>
+    void afterErase(TreeT &tree, NodeT *removed, NodeT *replacement, NodeT *parent)
+    {
+        unsigned int levels = retrace(tree, parent);
+        treeCount(tree.counters.eraseFixupLevels += levels);
+        (void)levels;
+    }
+    
+    template <typename NodeT>
+    void builtNode(NodeT *node, unsigned int depth, unsigned int lastDepth)
+    {
+        updateHeight(node);
+    }
+    
+    /// The root's height is the tree's.  The shallowest leaf is at least half as
+    /// deep: every node's shorter subtree is at most two levels shorter than its taller one.
+    template <typename TreeT>
+    void fillStats(const TreeT &tree, TreeStats &stats) const
+    {
+        unsigned int height = heightOf(tree.treeRoot);
+        
+        stats.minHeight = stats.maxHeight = height;
+        stats.minLeafDepth = height / 2;
+        stats.maxLeafDepth = (height > 0 ? height - 1 : 0);
+    }
+    
+    /// Measure is the height plus one (an empty subtree is 1)
+    template <typename NodeT>
+    unsigned int verifyNode(const NodeT *node, unsigned int leftMeasure, unsigned int rightMeasure) const
+    {
+        if (!verifyLocal(node))
+            return 0;
+        
+        // The stored heights agreed with each other; check them against the real ones
+        if (leftMeasure != heightOf(node->leftNode) + 1 || rightMeasure != heightOf(node->rightNode) + 1)
+        {
+            std::cerr << "Wrong height below node " << (void *)node << std::endl;
+            return 0;
+        }
+        
+        return node->balanceInfo + 1;
+    }
+    
+    template <typename NodeT>
+    bool verifyLocal(const NodeT *node) const
+    {
+        unsigned int leftHeight = heightOf(node->leftNode);
+        unsigned int rightHeight = heightOf(node->rightNode);
+        
+        if (node->balanceInfo != 1 + (leftHeight > rightHeight ? leftHeight : rightHeight))
+        {
+            std::cerr << "Wrong height " << node->balanceInfo << " at node " << (void *)node << std::endl;
+            return false;
+        }
+        
+        if (leftHeight > rightHeight + 1 || rightHeight > leftHeight + 1)
+        {
+            std::cerr << "AVL violation, node " << (void *)node << " heights "
+            << leftHeight << " and " << rightHeight << std::endl;
+            return false;
+        }
+        
+        return true;
+    }
+    
+    /// Nothing kept outside the nodes
+    template <typename TreeT>
+    bool verifyState(const TreeT &tree) const
+    {
+        return true;
+    }
+
+private:
+    static unsigned int heightOf(const TreeNode *node)
+    {
+        return (node != nullptr ? node->balanceInfo : 0);
+    }
+    
+    static void updateHeight(TreeNode *node)
+    {
+        unsigned int leftHeight = heightOf(node->leftNode);
+        unsigned int rightHeight = heightOf(node->rightNode);
+        
+        node->balanceInfo = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+    }
+    
+    /// Rotate, then fix the heights of the two nodes that moved, bottom one first
+    template <typename TreeT, typename NodeT>
+    static NodeT *rotate(TreeT &tree, NodeT *node, TreeNode::NodeDirection rotateDir)
+    {
+        NodeT *top = tree.rotate(node, rotateDir);
+        
+        updateHeight(node);
+        updateHeight(top);
+        return top;
+    }
+    
+    /// Fix node's height, rotating if its subtrees are two apart.  Returns whatever's
+    /// at the top of node's old subtree afterwards.
+    template <typename TreeT, typename NodeT>
+    static NodeT *rebalanceAt(TreeT &tree, NodeT *node)
+    {
+        NodeT *left = nodeCast<NodeT>(node->leftNode);
+        NodeT *right = nodeCast<NodeT>(node->rightNode);
+        unsigned int leftHeight = heightOf(left);
+        unsigned int rightHeight = heightOf(right);
+        
+        if (leftHeight > rightHeight + 1)
+        {
+            // Left heavy.  If it's the left child's right side that's taller, bring
+            // that up first, or it would just end up the taller side again.
+            if (heightOf(left->rightNode) > heightOf(left->leftNode))
+            {
+                treeCount(tree.counters.doubleRotations++);
+                rotate(tree, left, LEFT);
+            }
+            return rotate(tree, node, RIGHT);
+        }
+        
+        if (rightHeight > leftHeight + 1)
+        {
+            if (heightOf(right->leftNode) > heightOf(right->rightNode))
+            {
+                treeCount(tree.counters.doubleRotations++);
+                rotate(tree, right, RIGHT);
+            }
+            return rotate(tree, node, LEFT);
+        }
+        
+        updateHeight(node);
+        return node;
+    }
+    
+    /// Walk up from node until a subtree's height doesn't change.  Returns the
+    /// number of levels visited.
+    template <typename TreeT, typename NodeT>
+    static unsigned int retrace(TreeT &tree, NodeT *node)
+    {
+        unsigned int levels = 0;
+        
+        while (node != nullptr)
+        {
+            unsigned int oldHeight = node->balanceInfo;
+            NodeT *top = rebalanceAt(tree, node);
+            
+            levels++;
+            if (top->balanceInfo == oldHeight)
+                break;
+            
+            node = nodeCast<NodeT>(top->parentNode);
+        }
+        
+        return levels;
+    }
+};
+
+#endif /* defined(__Tree_exercises__AVLBalance__) */
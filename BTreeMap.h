@@ -0,0 +1,923 @@
+//
+//  BTreeMap.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__BTreeMap__
+#define __Tree_exercises__BTreeMap__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <assert.h>
+
+#include "NodeArena.h"
+#include "TreeMap.h"
+
+/**
+ Ordered map stored as a B+ tree, the mutable alternative to the red-black engine.
+ 
+ A red-black tree is a 2-3-4 tree in disguise (see the comments above
+ BinaryTree::reBalance), with each 2-3-4 node spread over up to three separately
+ allocated TreeNodes.  This stores the wide nodes as they are: each one is a
+ 256 byte, cache line aligned block with its keys side by side, so a search
+ looks at one block per level, and there are log_b(n) levels for a b of around
+ 15 instead of up to 2 log2(n).  Inserts split full nodes on the way down, the
+ way reBalance splits 4-nodes; erases borrow from or merge with a sibling on the
+ way back up.
+ 
+ Values only live in the leaves, which are chained together for iteration.
+ Blocks come out of a NodeArena, and erased ones are kept for reuse.  KeyT and
+ ValueT have to be default constructible and movable (node arrays are built
+ whole and shifted about), and are best kept small: an 8 byte key and value give
+ 14 entries a leaf and 15 keys an inner node.
+ 
+ The API follows TreeMap and CompactTreeMap: try_emplace, insert_or_assign,
+ operator[], find, contains, erase, lower_bound/upper_bound and bidirectional
+ iterators, which give getKey() and getMapped() (read-only through the
+ const_iterators a const map hands out).  Any insert or erase can move
+ entries between blocks, so iterators are only good until the next one.
+ **/
+template <typename KeyT, typename ValueT, typename CompareT = std::less<KeyT> >
+class BTreeMap
+{
+    struct Leaf;
+
+public:
+    typedef KeyT key_type;
+    typedef ValueT mapped_type;
+    typedef size_t size_type;
+    
+    /// Size of a node block: four cache lines
+    static const size_t nodeBytes = 256;
+    
+    /// What an iterator points at: one entry in a leaf.  Through a const_iterator
+    /// (leafType and valueType const) getMapped() is read-only.
+    template <typename leafType, typename valueType>
+    class btreeEntry
+    {
+    public:
+        btreeEntry(leafType *leaf, unsigned int slot) : theLeaf(leaf), theSlot(slot)
+        {
+            
+        }
+        
+        const KeyT &getKey() const
+        {
+            return theLeaf->keys[theSlot];
+        }
+        
+        valueType &getMapped() const
+        {
+            return theLeaf->values[theSlot];
+        }
+        
+        /// So it->getKey() works on an iterator, which has no Entry to point to
+        const btreeEntry *operator->() const
+        {
+            return this;
+        }
+    
+    private:
+        leafType *theLeaf;
+        unsigned int theSlot;
+    };
+    
+    typedef btreeEntry<Leaf, ValueT> Entry;
+    typedef btreeEntry<const Leaf, const ValueT> ConstEntry;
+    
+    /// Bidirectional iterator, walking the leaf chain.  end() is a null leaf;
+    /// decrementing it gets you the last entry.
+    template <typename leafType, typename entryType>
+    class btreeIterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef entryType value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef entryType pointer;
+        typedef entryType reference;
+        
+        btreeIterator() : theTree(nullptr), leaf(nullptr), slot(0)
+        {
+            
+        }
+        
+        btreeIterator(const BTreeMap *tree, leafType *theLeaf, unsigned int theSlot) : theTree(tree), leaf(theLeaf), slot(theSlot)
+        {
+            
+        }
+        
+        operator btreeIterator<const Leaf, ConstEntry>() const
+        {
+            return btreeIterator<const Leaf, ConstEntry>(theTree, leaf, slot);
+        }
+        
+        entryType operator*() const
+        {
+            return entryType(leaf, slot);
+        }
+        
+        entryType operator->() const
+        {
+            return entryType(leaf, slot);
+        }
+        
+        btreeIterator &operator++()
+        {
+            assert(leaf != nullptr);  // can't go past end()
+            if (++slot == leaf->count)
+            {
+                leaf = leaf->next;
+                slot = 0;
+            }
+            return *this;
+        }
+        
+        btreeIterator operator++(int)
+        {
+            btreeIterator before(*this);
+            ++(*this);
+            return before;
+        }
+        
+        btreeIterator &operator--()
+        {
+            if (leaf == nullptr)
+            {
+                leaf = theTree->lastLeaf;
+                slot = leaf->count;
+            }
+            else if (slot == 0)
+            {
+                leaf = leaf->prev;
+                slot = leaf->count;
+            }
+            slot--;
+            return *this;
+        }
+        
+        btreeIterator operator--(int)
+        {
+            btreeIterator before(*this);
+            --(*this);
+            return before;
+        }
+        
+        bool operator==(const btreeIterator &rhs) const
+        {
+            return leaf == rhs.leaf && slot == rhs.slot;
+        }
+        
+        bool operator!=(const btreeIterator &rhs) const
+        {
+            return !(*this == rhs);
+        }
+    
+    private:
+        const BTreeMap *theTree;
+        leafType *leaf;
+        unsigned int slot;
+    };
+    
+    typedef btreeIterator<Leaf, Entry> iterator;
+    typedef btreeIterator<const Leaf, ConstEntry> const_iterator;
+    
+    BTreeMap() : root(nullptr), firstLeaf(nullptr), lastLeaf(nullptr), freeLeaves(nullptr), freeInners(nullptr),
+                 nodeCount(0), height(0), nodeArena(16 * nodeBytes * 64)
+    {
+        
+    }
+    
+    ~BTreeMap()
+    {
+        destroyAll();
+    }
+    
+    size_t size() const
+    {
+        return nodeCount;
+    }
+    
+    bool empty() const
+    {
+        return nodeCount == 0;
+    }
+    
+    void clear()
+    {
+        destroyAll();
+        nodeArena.clear();
+        root = nullptr;
+        firstLeaf = lastLeaf = nullptr;
+        freeLeaves = nullptr;
+        freeInners = nullptr;
+        nodeCount = 0;
+        height = 0;
+    }
+    
+    /// Levels of blocks, leaves included
+    unsigned int getHeight() const
+    {
+        return height;
+    }
+    
+    size_t getBytesReserved() const
+    {
+        return nodeArena.getBytesReserved();
+    }
+    
+    iterator begin()
+    {
+        return iterator(this, firstLeaf, 0);
+    }
+    
+    iterator end()
+    {
+        return iterator(this, nullptr, 0);
+    }
+    
+    const_iterator begin() const
+    {
+        return const_iterator(this, firstLeaf, 0);
+    }
+    
+    const_iterator end() const
+    {
+        return const_iterator(this, nullptr, 0);
+    }
+    
+    /// Add key with value, unless key is already there.  Returns where key is, and
+    /// whether it's new.
+    std::pair<iterator, bool> try_emplace(const KeyT &key, const ValueT &value = ValueT());
+    
+    std::pair<iterator, bool> insert_or_assign(const KeyT &key, const ValueT &value)
+    {
+        std::pair<iterator, bool> result = try_emplace(key, value);
+        
+        if (!result.second)
+            result.first->getMapped() = value;
+        return result;
+    }
+    
+    ValueT &operator[](const KeyT &key)
+    {
+        return try_emplace(key).first->getMapped();
+    }
+    
+    iterator find(const KeyT &key)
+    {
+        return findEntry(key);
+    }
+    
+    const_iterator find(const KeyT &key) const
+    {
+        return findEntry(key);
+    }
+    
+    bool contains(const KeyT &key) const
+    {
+        return find(key) != end();
+    }
+    
+    /// First entry whose key isn't less than key (lower) or is greater (upper)
+    iterator lower_bound(const KeyT &key)
+    {
+        return boundEntry(key, false);
+    }
+    
+    iterator upper_bound(const KeyT &key)
+    {
+        return boundEntry(key, true);
+    }
+    
+    const_iterator lower_bound(const KeyT &key) const
+    {
+        return boundEntry(key, false);
+    }
+    
+    const_iterator upper_bound(const KeyT &key) const
+    {
+        return boundEntry(key, true);
+    }
+    
+    /// Remove key if it's there.  Returns the number of entries removed (0 or 1).
+    size_t erase(const KeyT &key);
+    
+    /// Check the whole tree: keys in order within and across blocks, every block
+    /// but the root at least half full, all leaves at the same depth, the leaf chain
+    /// and the entry count.  O(n), for debugging and tests.
+    bool verifyTree() const;
+
+private:
+    BTreeMap(const BTreeMap &) = delete;
+    BTreeMap &operator=(const BTreeMap &) = delete;
+    
+    struct Block
+    {
+        uint16_t count;     // keys in the block
+        bool isLeaf;
+    };
+    
+    /// How many entries fit in a block, given what each one costs
+    static constexpr size_t capacityFor(size_t header, size_t perEntry)
+    {
+        return (nodeBytes - header) / perEntry > 4 ? (nodeBytes - header) / perEntry : 4;
+    }
+    
+    static const unsigned int leafCapacity = capacityFor(sizeof(Block) + 2 * sizeof(void *), sizeof(KeyT) + sizeof(ValueT));
+    static const unsigned int innerCapacity = capacityFor(sizeof(Block) + sizeof(void *), sizeof(KeyT) + sizeof(void *));
+    
+    /// Fewest keys a block other than the root may have.  A split leaves at least
+    /// this many on each side, and two blocks that can't lend to each other fit in one.
+    static const unsigned int leafMinimum = leafCapacity / 2;
+    static const unsigned int innerMinimum = (innerCapacity - 1) / 2;
+    
+    struct alignas(64) Leaf : Block
+    {
+        Leaf *prev;
+        Leaf *next;
+        KeyT keys[leafCapacity];
+        ValueT values[leafCapacity];
+    };
+    
+    /// Keys in children[i] are >= keys[i - 1] and < keys[i]
+    struct alignas(64) Inner : Block
+    {
+        KeyT keys[innerCapacity];
+        Block *children[innerCapacity + 1];
+    };
+    
+    /// Number of keys in keys[0, count) that are less than key (upper: less than
+    /// or equal).  Small integer arrays are quicker to count through than to bisect.
+    static unsigned int rankOf(const KeyT *keys, unsigned int count, const KeyT &key, bool upper)
+    {
+        if (std::is_arithmetic<KeyT>::value)
+        {
+            unsigned int rank = 0;
+            int limit = (upper ? 0 : 1);
+            
+            for (unsigned int i = 0 ; i < count ; i++)
+                rank += (KeyOrder<KeyT, CompareT>::compare(key, keys[i]) >= limit);
+            return rank;
+        }
+        
+        unsigned int low = 0;
+        unsigned int high = count;
+        
+        while (low < high)
+        {
+            unsigned int middle = (low + high) / 2;
+            int compResult = KeyOrder<KeyT, CompareT>::compare(keys[middle], key);
+            
+            if (upper ? compResult <= 0 : compResult < 0)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return low;
+    }
+    
+    Leaf *newLeaf();
+    Inner *newInner();
+    void freeBlock(Block *block);
+    void destroyAll();
+    void splitChild(Inner *parent, unsigned int childIndex);
+    void rebalance(Block *block, Inner *parent, unsigned int childIndex);
+    
+    /// Shared by the const and non-const lookups; the public ones hand the result
+    /// back as a const_iterator where the map is const.
+    iterator findEntry(const KeyT &key) const;
+    iterator boundEntry(const KeyT &key, bool upper) const;
+    
+    bool verifyBlock(const Block *block, unsigned int depth, const KeyT *low, const KeyT *high,
+                     size_t &entries, const Leaf *&previousLeaf) const;
+    
+    /// Free blocks are chained through their first word
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+    
+    Block *root;
+    Leaf *firstLeaf;
+    Leaf *lastLeaf;
+    FreeBlock *freeLeaves;
+    FreeBlock *freeInners;
+    size_t nodeCount;
+    unsigned int height;
+    NodeArena nodeArena;
+};
+
+
+
+template <typename KeyT, typename ValueT, typename CompareT>
+typename BTreeMap<KeyT, ValueT, CompareT>::Leaf *BTreeMap<KeyT, ValueT, CompareT>::newLeaf()
+{
+    void *slot;
+    
+    if (freeLeaves != nullptr)
+    {
+        slot = freeLeaves;
+        freeLeaves = freeLeaves->next;
+    }
+    else
+    {
+        slot = nodeArena.allocate(sizeof(Leaf), alignof(Leaf));
+    }
+    
+    Leaf *leaf = new (slot) Leaf;
+    leaf->count = 0;
+    leaf->isLeaf = true;
+    leaf->prev = leaf->next = nullptr;
+    return leaf;
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+typename BTreeMap<KeyT, ValueT, CompareT>::Inner *BTreeMap<KeyT, ValueT, CompareT>::newInner()
+{
+    void *slot;
+    
+    if (freeInners != nullptr)
+    {
+        slot = freeInners;
+        freeInners = freeInners->next;
+    }
+    else
+    {
+        slot = nodeArena.allocate(sizeof(Inner), alignof(Inner));
+    }
+    
+    Inner *inner = new (slot) Inner;
+    inner->count = 0;
+    inner->isLeaf = false;
+    return inner;
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+void BTreeMap<KeyT, ValueT, CompareT>::freeBlock(Block *block)
+{
+    FreeBlock *slot;
+    
+    if (block->isLeaf)
+    {
+        static_cast<Leaf *>(block)->~Leaf();
+        slot = reinterpret_cast<FreeBlock *>(block);
+        slot->next = freeLeaves;
+        freeLeaves = slot;
+    }
+    else
+    {
+        static_cast<Inner *>(block)->~Inner();
+        slot = reinterpret_cast<FreeBlock *>(block);
+        slot->next = freeInners;
+        freeInners = slot;
+    }
+}
+
+// Run the blocks' destructors, if they have anything to do; the arena takes care
+// of the memory
+template <typename KeyT, typename ValueT, typename CompareT>
+void BTreeMap<KeyT, ValueT, CompareT>::destroyAll()
+{
+    if (std::is_trivially_destructible<KeyT>::value && std::is_trivially_destructible<ValueT>::value)
+        return;
+    
+    // Inner blocks first, a level at a time, then the leaves along their chain
+    std::vector<Block *> level;
+    
+    if (root != nullptr && !root->isLeaf)
+        level.push_back(root);
+    
+    while (!level.empty())
+    {
+        std::vector<Block *> below;
+        
+        for (Block *block : level)
+        {
+            Inner *inner = static_cast<Inner *>(block);
+            
+            for (unsigned int i = 0 ; i <= inner->count ; i++)
+                if (!inner->children[i]->isLeaf)
+                    below.push_back(inner->children[i]);
+            inner->~Inner();
+        }
+        level.swap(below);
+    }
+    
+    for (Leaf *leaf = firstLeaf ; leaf != nullptr ; )
+    {
+        Leaf *next = leaf->next;
+        leaf->~Leaf();
+        leaf = next;
+    }
+}
+
+// children[childIndex] is full.  Split it in two and hang the new right half,
+// and the key that separates them, off parent (which isn't full).
+template <typename KeyT, typename ValueT, typename CompareT>
+void BTreeMap<KeyT, ValueT, CompareT>::splitChild(Inner *parent, unsigned int childIndex)
+{
+    Block *child = parent->children[childIndex];
+    Block *right;
+    KeyT separator;
+    
+    if (child->isLeaf)
+    {
+        Leaf *left = static_cast<Leaf *>(child);
+        Leaf *newRight = newLeaf();
+        unsigned int keep = leafCapacity / 2;
+        
+        newRight->count = left->count - keep;
+        std::move(left->keys + keep, left->keys + left->count, newRight->keys);
+        std::move(left->values + keep, left->values + left->count, newRight->values);
+        left->count = keep;
+        
+        newRight->prev = left;
+        newRight->next = left->next;
+        if (left->next != nullptr)
+            left->next->prev = newRight;
+        else
+            lastLeaf = newRight;
+        left->next = newRight;
+        
+        // In a B+ tree the separator is a copy; the key itself stays in the leaf
+        separator = newRight->keys[0];
+        right = newRight;
+    }
+    else
+    {
+        Inner *left = static_cast<Inner *>(child);
+        Inner *newRight = newInner();
+        unsigned int middle = left->count / 2;
+        
+        newRight->count = left->count - middle - 1;
+        std::move(left->keys + middle + 1, left->keys + left->count, newRight->keys);
+        std::copy(left->children + middle + 1, left->children + left->count + 1, newRight->children);
+        separator = std::move(left->keys[middle]);
+        left->count = middle;
+        
+        right = newRight;
+    }
+    
+    std::move_backward(parent->keys + childIndex, parent->keys + parent->count, parent->keys + parent->count + 1);
+    std::copy_backward(parent->children + childIndex + 1, parent->children + parent->count + 1,
+                       parent->children + parent->count + 2);
+    parent->keys[childIndex] = std::move(separator);
+    parent->children[childIndex + 1] = right;
+    parent->count++;
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+std::pair<typename BTreeMap<KeyT, ValueT, CompareT>::iterator, bool>
+BTreeMap<KeyT, ValueT, CompareT>::try_emplace(const KeyT &key, const ValueT &value)
+{
+    if (root == nullptr)
+    {
+        firstLeaf = lastLeaf = newLeaf();
+        root = firstLeaf;
+        height = 1;
+    }
+    
+    // Split a full root first, so every block we go down into has room to take
+    // the key a split below it pushes up
+    bool rootFull = (root->isLeaf ? root->count == leafCapacity : root->count == innerCapacity);
+    if (rootFull)
+    {
+        Inner *newRoot = newInner();
+        
+        newRoot->children[0] = root;
+        splitChild(newRoot, 0);
+        root = newRoot;
+        height++;
+    }
+    
+    Block *block = root;
+    
+    while (!block->isLeaf)
+    {
+        Inner *inner = static_cast<Inner *>(block);
+        unsigned int childIndex = rankOf(inner->keys, inner->count, key, true);
+        Block *child = inner->children[childIndex];
+        bool childFull = (child->isLeaf ? child->count == leafCapacity : child->count == innerCapacity);
+        
+        if (childFull)
+        {
+            splitChild(inner, childIndex);
+            if (KeyOrder<KeyT, CompareT>::compare(key, inner->keys[childIndex]) >= 0)
+                childIndex++;
+        }
+        block = inner->children[childIndex];
+    }
+    
+    Leaf *leaf = static_cast<Leaf *>(block);
+    unsigned int slot = rankOf(leaf->keys, leaf->count, key, false);
+    
+    if (slot < leaf->count && KeyOrder<KeyT, CompareT>::compare(leaf->keys[slot], key) == 0)
+        return std::make_pair(iterator(this, leaf, slot), false);
+    
+    std::move_backward(leaf->keys + slot, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+    std::move_backward(leaf->values + slot, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+    leaf->keys[slot] = key;
+    leaf->values[slot] = value;
+    leaf->count++;
+    nodeCount++;
+    
+    return std::make_pair(iterator(this, leaf, slot), true);
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+typename BTreeMap<KeyT, ValueT, CompareT>::iterator
+BTreeMap<KeyT, ValueT, CompareT>::findEntry(const KeyT &key) const
+{
+    iterator it = boundEntry(key, false);
+    iterator none(this, nullptr, 0);
+    
+    if (it != none && KeyOrder<KeyT, CompareT>::compare(it->getKey(), key) == 0)
+        return it;
+    return none;
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+typename BTreeMap<KeyT, ValueT, CompareT>::iterator
+BTreeMap<KeyT, ValueT, CompareT>::boundEntry(const KeyT &key, bool upper) const
+{
+    if (root == nullptr)
+        return iterator(this, nullptr, 0);
+    
+    const Block *block = root;
+    
+    // Keys equal to a separator live to its right, so go by <= for both bounds
+    while (!block->isLeaf)
+    {
+        const Inner *inner = static_cast<const Inner *>(block);
+        block = inner->children[rankOf(inner->keys, inner->count, key, true)];
+    }
+    
+    Leaf *leaf = const_cast<Leaf *>(static_cast<const Leaf *>(block));
+    unsigned int slot = rankOf(leaf->keys, leaf->count, key, upper);
+    
+    // Everything in this leaf is smaller: the answer starts the next one
+    if (slot == leaf->count)
+        return iterator(this, leaf->next, 0);
+    return iterator(this, leaf, slot);
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+size_t BTreeMap<KeyT, ValueT, CompareT>::erase(const KeyT &key)
+{
+    if (root == nullptr)
+        return 0;
+    
+    // Remember the way down, to fix up underfull blocks on the way back
+    Inner *parents[64];
+    unsigned int childIndexes[64];
+    unsigned int depth = 0;
+    Block *block = root;
+    
+    while (!block->isLeaf)
+    {
+        Inner *inner = static_cast<Inner *>(block);
+        unsigned int childIndex = rankOf(inner->keys, inner->count, key, true);
+        
+        parents[depth] = inner;
+        childIndexes[depth] = childIndex;
+        depth++;
+        block = inner->children[childIndex];
+    }
+    
+    Leaf *leaf = static_cast<Leaf *>(block);
+    unsigned int slot = rankOf(leaf->keys, leaf->count, key, false);
+    
+    if (slot == leaf->count || KeyOrder<KeyT, CompareT>::compare(leaf->keys[slot], key) != 0)
+        return 0;
+    
+    std::move(leaf->keys + slot + 1, leaf->keys + leaf->count, leaf->keys + slot);
+    std::move(leaf->values + slot + 1, leaf->values + leaf->count, leaf->values + slot);
+    leaf->count--;
+    leaf->keys[leaf->count] = KeyT();
+    leaf->values[leaf->count] = ValueT();
+    nodeCount--;
+    
+    while (depth > 0)
+    {
+        unsigned int minimum = (block->isLeaf ? leafMinimum : innerMinimum);
+        
+        if (block->count >= minimum)
+            break;
+        
+        depth--;
+        rebalance(block, parents[depth], childIndexes[depth]);
+        block = parents[depth];
+    }
+    
+    // A root with no keys left has one child (or, for a leaf, none), which takes over
+    if (!root->isLeaf && root->count == 0)
+    {
+        Block *oldRoot = root;
+        
+        root = static_cast<Inner *>(root)->children[0];
+        freeBlock(oldRoot);
+        height--;
+    }
+    else if (root->isLeaf && root->count == 0)
+    {
+        freeBlock(root);
+        root = nullptr;
+        firstLeaf = lastLeaf = nullptr;
+        height = 0;
+    }
+    
+    return 1;
+}
+
+// block, parent's child childIndex, has one key too few.  Take one from a
+// neighbour that can spare it, or else merge with a neighbour.
+template <typename KeyT, typename ValueT, typename CompareT>
+void BTreeMap<KeyT, ValueT, CompareT>::rebalance(Block *block, Inner *parent, unsigned int childIndex)
+{
+    Block *leftBlock = (childIndex > 0 ? parent->children[childIndex - 1] : nullptr);
+    Block *rightBlock = (childIndex < parent->count ? parent->children[childIndex + 1] : nullptr);
+    unsigned int minimum = (block->isLeaf ? leafMinimum : innerMinimum);
+    
+    if (block->isLeaf)
+    {
+        Leaf *leaf = static_cast<Leaf *>(block);
+        Leaf *left = static_cast<Leaf *>(leftBlock);
+        Leaf *right = static_cast<Leaf *>(rightBlock);
+        
+        if (left != nullptr && left->count > minimum)
+        {
+            std::move_backward(leaf->keys, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+            std::move_backward(leaf->values, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+            left->count--;
+            leaf->keys[0] = std::move(left->keys[left->count]);
+            leaf->values[0] = std::move(left->values[left->count]);
+            leaf->count++;
+            parent->keys[childIndex - 1] = leaf->keys[0];
+            return;
+        }
+        
+        if (right != nullptr && right->count > minimum)
+        {
+            leaf->keys[leaf->count] = std::move(right->keys[0]);
+            leaf->values[leaf->count] = std::move(right->values[0]);
+            leaf->count++;
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            std::move(right->values + 1, right->values + right->count, right->values);
+            right->count--;
+            parent->keys[childIndex] = right->keys[0];
+            return;
+        }
+        
+        // Merge the right one of the pair into the left one
+        if (left == nullptr)
+        {
+            left = leaf;
+            childIndex++;
+        }
+        right = static_cast<Leaf *>(parent->children[childIndex]);
+        
+        std::move(right->keys, right->keys + right->count, left->keys + left->count);
+        std::move(right->values, right->values + right->count, left->values + left->count);
+        left->count += right->count;
+        
+        left->next = right->next;
+        if (right->next != nullptr)
+            right->next->prev = left;
+        else
+            lastLeaf = left;
+    }
+    else
+    {
+        Inner *inner = static_cast<Inner *>(block);
+        Inner *left = static_cast<Inner *>(leftBlock);
+        Inner *right = static_cast<Inner *>(rightBlock);
+        
+        // Borrowing rotates a key through the parent
+        if (left != nullptr && left->count > minimum)
+        {
+            std::move_backward(inner->keys, inner->keys + inner->count, inner->keys + inner->count + 1);
+            std::copy_backward(inner->children, inner->children + inner->count + 1, inner->children + inner->count + 2);
+            inner->keys[0] = std::move(parent->keys[childIndex - 1]);
+            inner->children[0] = left->children[left->count];
+            inner->count++;
+            parent->keys[childIndex - 1] = std::move(left->keys[left->count - 1]);
+            left->count--;
+            return;
+        }
+        
+        if (right != nullptr && right->count > minimum)
+        {
+            inner->keys[inner->count] = std::move(parent->keys[childIndex]);
+            inner->children[inner->count + 1] = right->children[0];
+            inner->count++;
+            parent->keys[childIndex] = std::move(right->keys[0]);
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            std::copy(right->children + 1, right->children + right->count + 1, right->children);
+            right->count--;
+            return;
+        }
+        
+        if (left == nullptr)
+        {
+            left = inner;
+            childIndex++;
+        }
+        right = static_cast<Inner *>(parent->children[childIndex]);
+        
+        // The separator comes down between them
+        left->keys[left->count] = std::move(parent->keys[childIndex - 1]);
+        std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+        std::copy(right->children, right->children + right->count + 1, left->children + left->count + 1);
+        left->count += right->count + 1;
+    }
+    
+    // Either way, the right block of the pair (now child childIndex) and its
+    // separator come out of the parent
+    Block *merged = parent->children[childIndex];
+    
+    std::move(parent->keys + childIndex, parent->keys + parent->count, parent->keys + childIndex - 1);
+    std::copy(parent->children + childIndex + 1, parent->children + parent->count + 1, parent->children + childIndex);
+    parent->count--;
+    freeBlock(merged);
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+bool BTreeMap<KeyT, ValueT, CompareT>::verifyTree() const
+{
+    size_t entries = 0;
+    const Leaf *previousLeaf = nullptr;
+    
+    if (root == nullptr)
+        return nodeCount == 0 && height == 0 && firstLeaf == nullptr && lastLeaf == nullptr;
+    
+    if (!verifyBlock(root, 1, nullptr, nullptr, entries, previousLeaf))
+        return false;
+    
+    return entries == nodeCount && previousLeaf == lastLeaf && lastLeaf->next == nullptr;
+}
+
+// Check block and everything under it.  Its keys have to be in [low, high),
+// where a null bound means unbounded.
+template <typename KeyT, typename ValueT, typename CompareT>
+bool BTreeMap<KeyT, ValueT, CompareT>::verifyBlock(const Block *block, unsigned int depth, const KeyT *low, const KeyT *high,
+                                                   size_t &entries, const Leaf *&previousLeaf) const
+{
+    unsigned int capacity = (block->isLeaf ? leafCapacity : innerCapacity);
+    unsigned int minimum = (block == root ? 1 : (block->isLeaf ? leafMinimum : innerMinimum));
+    
+    if (block->count < minimum || block->count > capacity)
+        return false;
+    
+    const KeyT *keys = (block->isLeaf ? static_cast<const Leaf *>(block)->keys : static_cast<const Inner *>(block)->keys);
+    
+    for (unsigned int i = 0 ; i < block->count ; i++)
+    {
+        if (i > 0 && KeyOrder<KeyT, CompareT>::compare(keys[i - 1], keys[i]) >= 0)
+            return false;
+        if (low != nullptr && KeyOrder<KeyT, CompareT>::compare(keys[i], *low) < 0)
+            return false;
+        if (high != nullptr && KeyOrder<KeyT, CompareT>::compare(keys[i], *high) >= 0)
+            return false;
+    }
+    
+    if (block->isLeaf)
+    {
+        const Leaf *leaf = static_cast<const Leaf *>(block);
+        
+        // Leaves all at the bottom, and chained in order
+        if (depth != height || leaf->prev != previousLeaf)
+            return false;
+        if (previousLeaf == nullptr ? leaf != firstLeaf : previousLeaf->next != leaf)
+            return false;
+        
+        previousLeaf = leaf;
+        entries += leaf->count;
+        return true;
+    }
+    
+    const Inner *inner = static_cast<const Inner *>(block);
+    
+    for (unsigned int i = 0 ; i <= inner->count ; i++)
+    {
+        const KeyT *childLow = (i > 0 ? &inner->keys[i - 1] : low);
+        const KeyT *childHigh = (i < inner->count ? &inner->keys[i] : high);
+        
+        if (!verifyBlock(inner->children[i], depth + 1, childLow, childHigh, entries, previousLeaf))
+            return false;
+    }
+    
+    return true;
+}
+
+#endif /* defined(__Tree_exercises__BTreeMap__) */
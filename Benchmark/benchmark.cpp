@@ -0,0 +1,1383 @@
+//
+//  benchmark.cpp
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+//  Benchmark BinaryTree<StringNode>, with each balance policy, against std::set
+//  and std::map on a set of reproducible workloads, and the red-black engine
+//  against the B-tree one on 64-bit keys.  Linux only (it forks, and reads /proc for memory).
+//  Doesn't need GraphViz, so it builds on its own:
+//
+//      cd Benchmark
+//      g++ -std=c++17 -O2 -DNDEBUG -pthread -I.. benchmark.cpp ../TreeNode.cpp ../NodeArena.cpp
+//          ../CaseFold.cpp ../TreeCounters.cpp ../MappedFile.cpp ../LineIndex.cpp
+//          ../EpochReclaim.cpp -o benchmark
+//
+//  Run with --help for the options.
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <map>
+#include <random>
+#include <type_traits>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "TreeNode.h"
+#include "BinaryTree.h"
+#include "AVLBalance.h"
+#include "TreapBalance.h"
+#include "StringNode.h"
+#include "ViewNode.h"
+#include "TreeMap.h"
+#include "BTreeMap.h"
+#include "CompactTree.h"
+#include "PersistentTree.h"
+#include "FrozenTree.h"
+#include "FrozenBTree.h"
+#include "MappedFile.h"
+#include "LineIndex.h"
+#include "CaseFold.h"
+
+/// The workloads.  Each one runs two timed phases on a fresh structure: a build
+/// phase, then a phase of n lookups (or n mixed operations).
+enum Workload
+{
+    workloadSorted,     // insert keys in ascending order, uniform lookups
+    workloadReverse,    // insert keys in descending order, uniform lookups
+    workloadRandom,     // insert keys in random order, uniform lookups
+    workloadZipf,       // n Zipf distributed inserts (lots of duplicates), Zipf lookups
+    workloadMixed,      // build half the keys, then 50% lookup, 25% insert, 25% erase
+    workloadCount
+};
+
+static const char *workloadNames[workloadCount] = { "sorted", "reverse", "random", "zipf", "mixed" };
+
+enum Structure
+{
+    structureTree,      // BinaryTree<StringNode>
+    structureAVL,       // BinaryTree<StringNode, AVLBalance>
+    structureTreap,     // BinaryTree<StringNode, TreapBalance>
+    structureSet,       // std::set<string>
+    structureMap,       // std::map<string, size_t>
+    structureTreeMap,   // TreeMap<uint64_t, size_t>, the red-black engine on integer keys
+    structureBTreeMap,  // BTreeMap<uint64_t, size_t>, the B-tree engine on the same keys
+    structureCompact,   // CompactTreeMap<uint64_t, uint32_t>, 24 byte red-black nodes
+    structurePersistent, // PersistentTreeMap<uint64_t, size_t>, with a snapshot kept alive
+    structureFrozen,    // TreeMap64's tree, looked up through a FrozenTree of it
+    structureFrozenBTree, // the same through a FrozenBTree
+    structureCount
+};
+
+static const char *structureNames[structureCount] = { "BinaryTree", "AVLTree", "Treap", "std::set", "std::map", "TreeMap64", "BTreeMap64",
+                                                      "Compact64", "PTreeMap64", "Frozen64",
+                                                      "FrozenB64" };
+
+struct BenchmarkOptions
+{
+    size_t minSize;
+    size_t maxSize;
+    double zipfExponent;
+    unsigned int seed;
+    const char *dictionary;
+    unsigned int readers;
+    bool runWorkload[workloadCount];
+    bool runStructure[structureCount];
+};
+
+/// What a child process sends back up the pipe
+struct PhaseResult
+{
+    unsigned long long operations;
+    unsigned long long nanoseconds;
+};
+
+struct RunResult
+{
+    PhaseResult build;
+    PhaseResult query;
+    size_t finalSize;
+    long baselineRssKB;     // keys and operation lists generated, structure not built yet
+    long peakRssKB;
+};
+
+/// Orders the way StringNode does, so every structure sorts (and dedups) the same
+struct FoldLess
+{
+    bool operator()(const string &lhs, const string &rhs) const
+    {
+        return foldCompare(lhs.data(), lhs.length(), rhs.data(), rhs.length()) < 0;
+    }
+};
+
+/// n distinct keys, all in one buffer, sorted the way the tree sorts them.
+/// Each key is four letters picked by hashing its number, so keys are spread all
+/// over the key space, followed by the number itself in base 26 to keep them distinct.
+///
+/// Each key also has a 64-bit id, for the integer keyed structures, which sorts
+/// the same way the keys do.
+class KeySet
+{
+public:
+    KeySet(size_t n, unsigned int seed) : theSeed(seed)
+    {
+        vector<size_t> offsets;
+        
+        offsets.reserve(n + 1);
+        keyBytes.reserve(n * 10);
+        
+        for (size_t i = 0 ; i < n ; i++)
+        {
+            uint64_t hash = mix(i ^ ((uint64_t)seed << 32));
+            
+            offsets.push_back(keyBytes.size());
+            for (int c = 0 ; c < 4 ; c++, hash /= 26)
+                keyBytes.push_back('a' + hash % 26);
+            
+            size_t number = i;
+            do
+            {
+                keyBytes.push_back('a' + number % 26);
+                number /= 26;
+            } while (number > 0);
+        }
+        offsets.push_back(keyBytes.size());
+        
+        keys.reserve(n);
+        for (size_t i = 0 ; i < n ; i++)
+            keys.push_back(string_view(&keyBytes[offsets[i]], offsets[i + 1] - offsets[i]));
+        
+        std::sort(keys.begin(), keys.end(), [](string_view lhs, string_view rhs)
+                  {
+                      return foldCompare(lhs.data(), lhs.length(), rhs.data(), rhs.length()) < 0;
+                  });
+    }
+    
+    string_view operator[](size_t i) const
+    {
+        return keys[i];
+    }
+    
+    size_t size() const
+    {
+        return keys.size();
+    }
+    
+    /// Key i's index in the top bits, random bits below it
+    uint64_t getId(size_t i) const
+    {
+        return ((uint64_t)i << 28) | (mix(i ^ ((uint64_t)theSeed << 32) ^ 0x5bd1e995) & 0xfffffff);
+    }
+
+private:
+    /// splitmix64's finalizer
+    static uint64_t mix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+    
+    vector<char> keyBytes;
+    vector<string_view> keys;
+    unsigned int theSeed;
+};
+
+/// Zipf distributed ranks in [0, n), rank 0 the most popular.  Inverts the
+/// continuous approximation of the Zipf CDF, which is close enough for load
+/// generation and needs no table (a table for 10^8 keys would be bigger than the tree).
+class ZipfGenerator
+{
+public:
+    ZipfGenerator(size_t n, double exponent) : itemCount(n), s(exponent)
+    {
+        maxH = integral((double)n + 1.0);
+    }
+    
+    template <typename EngineT>
+    size_t operator()(EngineT &engine)
+    {
+        double u = std::uniform_real_distribution<double>(0.0, maxH)(engine);
+        double x = (std::fabs(s - 1.0) < 1e-9 ? std::exp(u) : std::pow(1.0 + u * (1.0 - s), 1.0 / (1.0 - s)));
+        size_t rank = (size_t)x - 1;
+        
+        return (rank < itemCount ? rank : itemCount - 1);
+    }
+
+private:
+    double integral(double x) const
+    {
+        if (std::fabs(s - 1.0) < 1e-9)
+            return std::log(x);
+        
+        return (std::pow(x, 1.0 - s) - 1.0) / (1.0 - s);
+    }
+    
+    size_t itemCount;
+    double s;
+    double maxH;
+};
+
+/// One operation of a workload, on the key with index keyIndex
+struct Operation
+{
+    enum Kind : uint8_t
+    {
+        insert,
+        lookup,
+        erase
+    };
+    
+    uint32_t keyIndex;
+    Kind kind;
+};
+
+/// The operation lists for a workload, worked out before any timing starts
+struct WorkloadPlan
+{
+    vector<Operation> build;
+    vector<Operation> query;
+};
+
+static WorkloadPlan planWorkload(Workload workload, size_t n, const BenchmarkOptions &options)
+{
+    WorkloadPlan plan;
+    std::mt19937_64 engine(options.seed + n * workloadCount + workload);
+    std::uniform_int_distribution<size_t> uniform(0, n - 1);
+    
+    plan.build.reserve(workload == workloadMixed ? n / 2 : n);
+    plan.query.reserve(n);
+    
+    switch (workload)
+    {
+        case workloadSorted:
+        case workloadReverse:
+        case workloadRandom:
+        {
+            vector<uint32_t> order(n);
+            
+            for (size_t i = 0 ; i < n ; i++)
+                order[i] = (uint32_t)(workload == workloadReverse ? n - 1 - i : i);
+            
+            if (workload == workloadRandom)
+                std::shuffle(order.begin(), order.end(), engine);
+            
+            for (uint32_t keyIndex : order)
+                plan.build.push_back({ keyIndex, Operation::insert });
+            
+            for (size_t i = 0 ; i < n ; i++)
+                plan.query.push_back({ (uint32_t)uniform(engine), Operation::lookup });
+            break;
+        }
+        
+        case workloadZipf:
+        {
+            // Shuffle which keys are the popular ones, so they aren't all the smallest
+            vector<uint32_t> byRank(n);
+            ZipfGenerator zipf(n, options.zipfExponent);
+            
+            for (size_t i = 0 ; i < n ; i++)
+                byRank[i] = (uint32_t)i;
+            std::shuffle(byRank.begin(), byRank.end(), engine);
+            
+            for (size_t i = 0 ; i < n ; i++)
+                plan.build.push_back({ byRank[zipf(engine)], Operation::insert });
+            
+            for (size_t i = 0 ; i < n ; i++)
+                plan.query.push_back({ byRank[zipf(engine)], Operation::lookup });
+            break;
+        }
+        
+        case workloadMixed:
+        default:
+        {
+            vector<uint32_t> order(n);
+            
+            for (size_t i = 0 ; i < n ; i++)
+                order[i] = (uint32_t)i;
+            std::shuffle(order.begin(), order.end(), engine);
+            
+            for (size_t i = 0 ; i < n / 2 ; i++)
+                plan.build.push_back({ order[i], Operation::insert });
+            
+            std::uniform_int_distribution<int> kind(0, 3);
+            for (size_t i = 0 ; i < n ; i++)
+            {
+                int pick = kind(engine);
+                
+                plan.query.push_back({ (uint32_t)uniform(engine),
+                                       pick < 2 ? Operation::lookup : (pick == 2 ? Operation::insert : Operation::erase) });
+            }
+            break;
+        }
+    }
+    
+    return plan;
+}
+
+/// Keeps the compiler from throwing away lookups whose results we don't use
+static volatile size_t sink;
+
+/// Thin wrappers so one timing loop can drive every structure.  key_type says
+/// which kind of key, the string or its id, the structure gets.
+template <typename BalancePolicy>
+class TreeAdapter
+{
+public:
+    typedef string_view key_type;
+    
+    TreeAdapter()
+    {
+        tree.setValidation(BinaryTree<StringNode, BalancePolicy>::validateOff);
+    }
+    
+    void insert(string_view key)
+    {
+        // Only builds a node if the key is new
+        tree.try_emplace(key);
+    }
+    
+    bool lookup(string_view key)
+    {
+        return tree.contains(key);
+    }
+    
+    void erase(string_view key)
+    {
+        tree.erase(key);
+    }
+    
+    size_t size() const
+    {
+        return tree.size();
+    }
+    
+    void report() const
+    {
+#ifdef TREE_COUNTERS
+        tree.getCounters().dump(stderr);
+#endif
+    }
+
+private:
+    BinaryTree<StringNode, BalancePolicy> tree;
+};
+
+class SetAdapter
+{
+public:
+    typedef string_view key_type;
+    
+    void insert(string_view key)
+    {
+        theSet.insert(string(key));
+    }
+    
+    bool lookup(string_view key)
+    {
+        return theSet.find(string(key)) != theSet.end();
+    }
+    
+    void erase(string_view key)
+    {
+        theSet.erase(string(key));
+    }
+    
+    size_t size() const
+    {
+        return theSet.size();
+    }
+    
+    void report() const
+    {
+        
+    }
+
+private:
+    std::set<string, FoldLess> theSet;
+};
+
+class MapAdapter
+{
+public:
+    typedef string_view key_type;
+    
+    void insert(string_view key)
+    {
+        theMap.emplace(string(key), theMap.size());
+    }
+    
+    bool lookup(string_view key)
+    {
+        return theMap.find(string(key)) != theMap.end();
+    }
+    
+    void erase(string_view key)
+    {
+        theMap.erase(string(key));
+    }
+    
+    size_t size() const
+    {
+        return theMap.size();
+    }
+    
+    void report() const
+    {
+        
+    }
+
+private:
+    std::map<string, size_t, FoldLess> theMap;
+};
+
+class TreeMapAdapter
+{
+public:
+    typedef uint64_t key_type;
+    
+    TreeMapAdapter()
+    {
+        theMap.setValidation(TreeMap<uint64_t, size_t>::tree_type::validateOff);
+    }
+    
+    void insert(uint64_t key)
+    {
+        theMap.try_emplace(key, theMap.size());
+    }
+    
+    bool lookup(uint64_t key)
+    {
+        return theMap.contains(key);
+    }
+    
+    void erase(uint64_t key)
+    {
+        theMap.erase(key);
+    }
+    
+    size_t size() const
+    {
+        return theMap.size();
+    }
+    
+    void report() const
+    {
+        
+    }
+
+private:
+    TreeMap<uint64_t, size_t> theMap;
+};
+
+class BTreeMapAdapter
+{
+public:
+    typedef uint64_t key_type;
+    
+    void insert(uint64_t key)
+    {
+        theMap.try_emplace(key, theMap.size());
+    }
+    
+    bool lookup(uint64_t key)
+    {
+        return theMap.contains(key);
+    }
+    
+    void erase(uint64_t key)
+    {
+        theMap.erase(key);
+    }
+    
+    size_t size() const
+    {
+        return theMap.size();
+    }
+    
+    void report() const
+    {
+        
+    }
+
+private:
+    BTreeMap<uint64_t, size_t> theMap;
+};
+
+/// CompactTreeMap with 32-bit values, so its nodes are the 24 bytes CompactTree.h
+/// says they are, and struct RSS can be held up against TreeMap64's.
+class CompactAdapter
+{
+public:
+    typedef uint64_t key_type;
+    
+    void insert(uint64_t key)
+    {
+        theMap.try_emplace(key, (uint32_t)theMap.size());
+    }
+    
+    bool lookup(uint64_t key)
+    {
+        return theMap.contains(key);
+    }
+    
+    void erase(uint64_t key)
+    {
+        theMap.erase(key);
+    }
+    
+    size_t size() const
+    {
+        return theMap.size();
+    }
+    
+    void report() const
+    {
+        
+    }
+
+private:
+    CompactTreeMap<uint64_t, uint32_t> theMap;
+    
+    static_assert(sizeof(CompactTreeMap<uint64_t, uint32_t>::Node) == 24, "compact nodes grew");
+};
+
+/// Holds on to a snapshot, renewed every snapshotInterval changes, the way a
+/// reader working from an old version would.  So changes pay for copying their
+/// paths, at least the first time through each part of the tree after a snapshot.
+class PersistentAdapter
+{
+public:
+    typedef uint64_t key_type;
+    
+    PersistentAdapter() : changes(0)
+    {
+        
+    }
+    
+    void insert(uint64_t key)
+    {
+        if (theMap.try_emplace(key, theMap.size()))
+            changed();
+    }
+    
+    bool lookup(uint64_t key)
+    {
+        return theMap.contains(key);
+    }
+    
+    void erase(uint64_t key)
+    {
+        if (theMap.erase(key) != 0)
+            changed();
+    }
+    
+    size_t size() const
+    {
+        return theMap.size();
+    }
+    
+    void report() const
+    {
+        
+    }
+
+private:
+    static const unsigned int snapshotInterval = 1024;
+    
+    void changed()
+    {
+        if (++changes % snapshotInterval == 0)
+            lastSnapshot = theMap.snapshot();
+    }
+    
+    PersistentTreeMap<uint64_t, size_t> theMap;
+    PersistentTreeMap<uint64_t, size_t>::Snapshot lastSnapshot;
+    unsigned long changes;
+};
+
+/// TreeMap64's tree, looked up through a read-only copy of it (FrozenT, FrozenTree
+/// or FrozenBTree).  Changes go to the tree and leave the copy stale, and lookups go
+/// to the tree until enough of them have come in a row to pay for freezing it
+/// again, one per freezeRatio keys.  So a workload that builds and then only
+/// queries is nearly all frozen lookups, and a mixed one is all tree lookups.
+///
+/// report() checks a copy against the tree: find, lower_bound and upper_bound on
+/// every key and the keys either side of it.  A mismatch fails the run.
+template <typename FrozenT>
+class FrozenAdapter
+{
+public:
+    typedef uint64_t key_type;
+    typedef TreeMap<uint64_t, size_t>::node_type node_type;
+    typedef TreeMap<uint64_t, size_t>::tree_type tree_type;
+    
+    FrozenAdapter() : lookupsSinceChange(0)
+    {
+        tree.setValidation(tree_type::validateOff);
+    }
+    
+    void insert(uint64_t key)
+    {
+        if (tree.try_emplace(key, tree.size()).second)
+            changed();
+    }
+    
+    bool lookup(uint64_t key)
+    {
+        if (!frozen && ++lookupsSinceChange * freezeRatio >= tree.size())
+            frozen.reset(new FrozenT(tree));
+        
+        return (frozen ? frozen->contains(key) : tree.contains(key));
+    }
+    
+    void erase(uint64_t key)
+    {
+        if (tree.erase(key) != 0)
+            changed();
+    }
+    
+    size_t size() const
+    {
+        return tree.size();
+    }
+    
+    void report() const
+    {
+        FrozenT copy(tree);
+        
+        for (const node_type &node : tree)
+        {
+            uint64_t key = node.getKey();
+            
+            if (!agrees(copy, key) || (key > 0 && !agrees(copy, key - 1)) || (key < UINT64_MAX && !agrees(copy, key + 1)))
+                exit(1);
+        }
+        
+        if (!agrees(copy, 0) || !agrees(copy, UINT64_MAX))
+            exit(1);
+    }
+
+private:
+    static const size_t freezeRatio = 16;
+    
+    void changed()
+    {
+        frozen.reset();
+        lookupsSinceChange = 0;
+    }
+    
+    bool agrees(const FrozenT &copy, uint64_t key) const
+    {
+        if (copy.find(key) == tree.find(key) && copy.lower_bound(key) == tree.lower_bound(key) &&
+            copy.upper_bound(key) == tree.upper_bound(key))
+            return true;
+        
+        fprintf(stderr, "frozen copy disagrees with the tree about key %llu\n", (unsigned long long)key);
+        return false;
+    }
+    
+    tree_type tree;
+    std::unique_ptr<FrozenT> frozen;   // null while it's stale
+    size_t lookupsSinceChange;
+};
+
+template <typename AdapterT>
+static PhaseResult runPhase(AdapterT &adapter, const vector<Operation> &operations, const KeySet &keys)
+{
+    size_t hits = 0;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    
+    for (const Operation &op : operations)
+    {
+        typename AdapterT::key_type key;
+        
+        if constexpr (std::is_integral<typename AdapterT::key_type>::value)
+            key = keys.getId(op.keyIndex);
+        else
+            key = keys[op.keyIndex];
+        
+        switch (op.kind)
+        {
+            case Operation::insert:
+                adapter.insert(key);
+                break;
+            
+            case Operation::lookup:
+                hits += adapter.lookup(key);
+                break;
+            
+            case Operation::erase:
+                adapter.erase(key);
+                break;
+        }
+    }
+    
+    PhaseResult result;
+    result.operations = operations.size();
+    result.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    sink = hits;
+    
+    return result;
+}
+
+/// Resident set size right now, from /proc
+static long currentRssKB()
+{
+    long totalPages = 0;
+    long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    
+    if (statm != nullptr)
+    {
+        if (fscanf(statm, "%ld %ld", &totalPages, &pages) != 2)
+            pages = 0;
+        fclose(statm);
+    }
+    
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long peakRssKB()
+{
+    struct rusage usage;
+    
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;   // kilobytes, on Linux
+}
+
+template <typename AdapterT>
+static RunResult runStructure(const KeySet &keys, const WorkloadPlan &plan)
+{
+    RunResult result;
+    AdapterT adapter;
+    
+    result.baselineRssKB = currentRssKB();
+    result.build = runPhase(adapter, plan.build, keys);
+    result.query = runPhase(adapter, plan.query, keys);
+    result.finalSize = adapter.size();
+    result.peakRssKB = peakRssKB();
+    adapter.report();
+    
+    return result;
+}
+
+/// Run one structure on one workload, start to finish
+static RunResult benchmarkWorkload(Workload workload, Structure structure, size_t n, const BenchmarkOptions &options)
+{
+    KeySet keys(n, options.seed);
+    WorkloadPlan plan = planWorkload(workload, n, options);
+    
+    switch (structure)
+    {
+        case structureTree:
+            return runStructure<TreeAdapter<RedBlackBalance> >(keys, plan);
+            
+        case structureAVL:
+            return runStructure<TreeAdapter<AVLBalance> >(keys, plan);
+            
+        case structureTreap:
+            return runStructure<TreeAdapter<TreapBalance> >(keys, plan);
+            
+        case structureSet:
+            return runStructure<SetAdapter>(keys, plan);
+            
+        case structureMap:
+            return runStructure<MapAdapter>(keys, plan);
+            
+        case structureTreeMap:
+            return runStructure<TreeMapAdapter>(keys, plan);
+            
+        case structureBTreeMap:
+            return runStructure<BTreeMapAdapter>(keys, plan);
+            
+        case structureCompact:
+            return runStructure<CompactAdapter>(keys, plan);
+            
+        case structurePersistent:
+            return runStructure<PersistentAdapter>(keys, plan);
+            
+        case structureFrozen:
+            return runStructure<FrozenAdapter<FrozenTree<TreeMap<uint64_t, size_t>::node_type> > >(keys, plan);
+            
+        case structureFrozenBTree:
+        default:
+            return runStructure<FrozenAdapter<FrozenBTree<TreeMap<uint64_t, size_t>::node_type> > >(keys, plan);
+    }
+}
+
+/// Ways of getting a dictionary file into a tree, for --dictionary
+enum IngestMethod
+{
+    ingestStream,       // ifstream and getline into a vector<string>, then StringNodes
+    ingestMappedCopy,   // MappedFile lines, then StringNodes (one copy, into the arena)
+    ingestMappedView,   // MappedFile lines, then ViewNodes (no copies)
+    ingestCount
+};
+
+static const char *ingestNames[ingestCount] = { "ifstream", "mmap+copy", "mmap+view" };
+
+/// Look every word up again, in a shuffled order
+template <typename TreeT>
+static PhaseResult lookupAll(const TreeT &tree, vector<string_view> words, unsigned int seed)
+{
+    std::mt19937_64 engine(seed);
+    size_t hits = 0;
+    
+    std::shuffle(words.begin(), words.end(), engine);
+    
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    
+    for (string_view word : words)
+        hits += tree.contains(word);
+    
+    PhaseResult result;
+    result.operations = words.size();
+    result.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    sink = hits;
+    
+    return result;
+}
+
+/// Load the dictionary into a tree one way, and time that (build) and looking
+/// every word back up (query)
+static RunResult runIngest(IngestMethod method, const char *path, const BenchmarkOptions &options)
+{
+    RunResult result;
+    memset(&result, 0, sizeof(result));
+    result.baselineRssKB = currentRssKB();
+    
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    
+    if (method == ingestStream)
+    {
+        // What main.cpp used to do
+        std::ifstream instream(path, std::ifstream::in);
+        vector<string> wordList;
+        string word;
+        
+        while (std::getline(instream, word))
+        {
+            if (!word.empty())
+                wordList.push_back(word);
+        }
+        
+        BinaryTree<StringNode> tree;
+        tree.setValidation(BinaryTree<StringNode>::validateOff);
+        tree.buildFromUnsorted(wordList.begin(), wordList.end());
+        
+        result.build.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+        result.build.operations = wordList.size();
+        result.query = lookupAll(tree, vector<string_view>(wordList.begin(), wordList.end()), options.seed);
+        result.finalSize = tree.size();
+    }
+    else
+    {
+        MappedFile dictionary;   // has to outlive a tree of ViewNodes
+        
+        if (!dictionary.open(path))
+        {
+            perror(path);
+            _exit(1);
+        }
+        
+        vector<string_view> wordList = dictionary.lines();
+        
+        if (method == ingestMappedCopy)
+        {
+            BinaryTree<StringNode> tree;
+            tree.setValidation(BinaryTree<StringNode>::validateOff);
+            tree.buildFromUnsorted(wordList.begin(), wordList.end());
+            
+            result.build.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+            result.query = lookupAll(tree, wordList, options.seed);
+            result.finalSize = tree.size();
+        }
+        else
+        {
+            BinaryTree<ViewNode> tree;
+            tree.setValidation(BinaryTree<ViewNode>::validateOff);
+            tree.buildFromUnsorted(wordList.begin(), wordList.end());
+            
+            result.build.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+            result.query = lookupAll(tree, wordList, options.seed);
+            result.finalSize = tree.size();
+        }
+        
+        result.build.operations = wordList.size();
+    }
+    
+    result.peakRssKB = peakRssKB();
+    
+    return result;
+}
+
+/// Draw count lines from sampler, and print how fast that went
+static void timeSampler(const char *name, LineSampler &sampler, size_t count,
+                        std::chrono::steady_clock::time_point startTime)
+{
+    size_t total = 0;
+    size_t drawn = 0;
+    
+    for ( ; drawn < count && sampler.remaining() > 0 ; drawn++)
+        total += sampler.nextIndex();
+    
+    double nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    sink = total;
+    
+    printf("  %-30s %10zu draws %9.1f ns/draw %8.2f M draws/s\n",
+           name, drawn, nanoseconds / drawn, drawn * 1e3 / nanoseconds);
+}
+
+/// How fast a LineIndex builds, and how fast the samplers on it go.  Setup
+/// (e.g. the alias table) counts against the draws.
+static void runSampling(const char *path, const BenchmarkOptions &options)
+{
+    static const size_t drawCount = 10000000;
+    MappedFile dictionary;
+    LineIndex lineIndex;
+    
+    if (!dictionary.open(path))
+    {
+        perror(path);
+        return;
+    }
+    
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    lineIndex.build(dictionary);
+    double buildMilliseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count() / 1e3;
+    
+    printf("\nline index: %zu lines, built in %.1f ms\n", lineIndex.size(), buildMilliseconds);
+    if (lineIndex.size() == 0)
+        return;
+    
+    // Zipf-like weights, just to have something lopsided
+    vector<double> weights(lineIndex.size());
+    for (size_t i = 0 ; i < weights.size() ; i++)
+        weights[i] = 1.0 / (i + 1);
+    
+    startTime = std::chrono::steady_clock::now();
+    LineSampler uniform(lineIndex, true, options.seed);
+    timeSampler("uniform, with replacement", uniform, drawCount, startTime);
+    
+    startTime = std::chrono::steady_clock::now();
+    LineSampler shuffled(lineIndex, false, options.seed);
+    timeSampler("uniform, without replacement", shuffled, drawCount, startTime);
+    
+    startTime = std::chrono::steady_clock::now();
+    LineSampler weighted(lineIndex, weights, true, options.seed);
+    timeSampler("weighted, with replacement", weighted, drawCount, startTime);
+    
+    startTime = std::chrono::steady_clock::now();
+    LineSampler weightedOrder(lineIndex, weights, false, options.seed);
+    timeSampler("weighted, without replacement", weightedOrder, drawCount, startTime);
+}
+
+/// For --readers: the writer makes one change per this many lookups
+static const unsigned long long lookupsPerWrite = 1000;
+static const double concurrentSeconds = 1.0;
+
+/// Look keys up from readerCount threads for a while, as this thread keeps making
+/// changes (half the keys stay put, it inserts and erases the other half).  Either
+/// everyone takes one mutex, the way a plain tree has to be shared, or the readers
+/// go through lock free BinaryTree::Readers.  Returns false if a lookup of a key
+/// that stays put ever missed.
+static bool runConcurrent(const KeySet &keys, unsigned int readerCount, bool lockFree, unsigned int seed)
+{
+    typedef BinaryTree<StringNode> Tree;
+    Tree tree;
+    std::mutex treeLock;
+    std::atomic<bool> stop(false);
+    std::atomic<unsigned long long> lookups(0);
+    std::atomic<size_t> totalHits(0);
+    std::atomic<unsigned long long> permanentMisses(0);
+    vector<string_view> permanent;
+    
+    tree.setValidation(Tree::validateOff);
+    for (size_t i = 0 ; i < keys.size() ; i += 2)
+        permanent.push_back(keys[i]);
+    tree.buildFromSorted(permanent.begin(), permanent.end());
+    
+    if (lockFree)
+        tree.enableConcurrentReaders(readerCount);
+    
+    vector<std::thread> readers;
+    
+    for (unsigned int r = 0 ; r < readerCount ; r++)
+    {
+        readers.emplace_back([&, r]()
+        {
+            static const unsigned int batch = 256;   // lookups between updates of the shared count
+            std::mt19937_64 engine(seed + r + 1);
+            size_t hits = 0;
+            unsigned long long misses = 0;  // of even numbered keys, which are always there
+            
+            if (lockFree)
+            {
+                Tree::Reader reader(tree);
+                
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    for (unsigned int i = 0 ; i < batch ; i++)
+                    {
+                        size_t index = engine() % keys.size();
+                        bool found = reader.contains(keys[index]);
+                        
+                        hits += found;
+                        misses += (!found && index % 2 == 0);
+                    }
+                    lookups.fetch_add(batch, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    for (unsigned int i = 0 ; i < batch ; i++)
+                    {
+                        size_t index = engine() % keys.size();
+                        std::lock_guard<std::mutex> guard(treeLock);
+                        bool found = tree.contains(keys[index]);
+                        
+                        hits += found;
+                        misses += (!found && index % 2 == 0);
+                    }
+                    lookups.fetch_add(batch, std::memory_order_relaxed);
+                }
+            }
+            
+            totalHits.fetch_add(hits, std::memory_order_relaxed);
+            permanentMisses.fetch_add(misses, std::memory_order_relaxed);
+        });
+    }
+    
+    std::mt19937_64 engine(seed);
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    unsigned long long writes = 0;
+    double seconds = 0.0;
+    
+    while ((seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()) < concurrentSeconds)
+    {
+        // Keep to the ratio, rather than flooding the readers with changes
+        if (writes * lookupsPerWrite >= lookups.load(std::memory_order_relaxed))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        
+        string_view key = keys[(engine() % (keys.size() / 2)) * 2 + 1];
+        bool insert = (engine() & 1) != 0;
+        
+        if (lockFree)
+        {
+            if (insert) tree.try_emplace(key);
+            else tree.erase(key);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> guard(treeLock);
+            
+            if (insert) tree.try_emplace(key);
+            else tree.erase(key);
+        }
+        writes++;
+    }
+    
+    stop = true;
+    for (std::thread &reader : readers)
+        reader.join();
+    
+    double lookupRate = lookups.load() / seconds;
+    
+    sink = totalHits.load();
+    printf("%-8u %-10s %10.2f M lookups/s %9.1f ns/lookup/thread %9.0f writes/s\n",
+           readerCount, lockFree ? "lock free" : "mutex", lookupRate / 1e6,
+           readerCount * 1e9 / lookupRate, writes / seconds);
+    
+    if (permanentMisses.load() == 0)
+        return true;
+    
+    fprintf(stderr, "%llu lookups missed a key that was never erased\n", permanentMisses.load());
+    return false;
+}
+
+/// Run something in a child process, so it gets a clean heap and its own peak
+/// RSS, and hand back the RunResult it came up with.  Returns false if the child died.
+template <typename FuncT>
+static bool runInChild(FuncT run, RunResult &result)
+{
+    int fds[2];
+    
+    if (pipe(fds) < 0)
+    {
+        perror("pipe");
+        return false;
+    }
+    
+    fflush(stdout);
+    fflush(stderr);
+    
+    pid_t child = fork();
+    if (child < 0)
+    {
+        perror("fork");
+        return false;
+    }
+    
+    if (child == 0)
+    {
+        close(fds[0]);
+        
+        RunResult childResult = run();
+        
+        ssize_t written = write(fds[1], &childResult, sizeof(childResult));
+        _exit(written == sizeof(childResult) ? 0 : 1);
+    }
+    
+    close(fds[1]);
+    
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    int status = 0;
+    
+    close(fds[0]);
+    waitpid(child, &status, 0);
+    
+    return got == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void printPhase(const char *phase, const PhaseResult &phaseResult)
+{
+    double nsPerOp = (phaseResult.operations > 0 ? (double)phaseResult.nanoseconds / phaseResult.operations : 0.0);
+    double mopsPerSecond = (phaseResult.nanoseconds > 0 ? phaseResult.operations * 1e3 / phaseResult.nanoseconds : 0.0);
+    
+    printf("  %-6s %9.1f ns/op %8.2f Mops/s", phase, nsPerOp, mopsPerSecond);
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --min-size N        smallest tree size (default 1000)\n"
+            "  --max-size N        largest tree size, sizes go up by 10x (default 1000000, up to 1e8)\n"
+            "  --workloads LIST    comma separated: sorted,reverse,random,zipf,mixed (default all)\n"
+            "  --structures LIST   comma separated: tree,avl,treap,set,map,treemap,btree,\n"
+            "                      compact,persistent,frozen,frozenbtree (default all)\n"
+            "  --zipf S            Zipf exponent (default 0.99)\n"
+            "  --seed N            random seed (default 1), same seed gives the same keys and operations\n"
+            "  --dictionary PATH   instead, time loading a word list (one per line) into a tree three ways,\n"
+            "                      and drawing random words from it\n"
+            "  --readers N         instead, time lookups from 1, 2, 4... N threads on a max-size tree while\n"
+            "                      one writer changes it, with a mutex and with lock free Readers\n",
+            program);
+}
+
+/// Turn a comma separated list into flags, by prefix match against names
+static bool parseList(const char *list, const char *const *names, const char *const *shortNames,
+                      int count, bool *selected)
+{
+    for (int i = 0 ; i < count ; i++)
+        selected[i] = false;
+    
+    string all(list);
+    size_t start = 0;
+    
+    while (start <= all.length())
+    {
+        size_t comma = all.find(',', start);
+        string item = all.substr(start, comma == string::npos ? string::npos : comma - start);
+        bool matched = false;
+        
+        for (int i = 0 ; i < count ; i++)
+        {
+            if (item == names[i] || (shortNames != nullptr && item == shortNames[i]))
+            {
+                selected[i] = true;
+                matched = true;
+            }
+        }
+        
+        if (!matched)
+        {
+            fprintf(stderr, "Unknown name '%s'\n", item.c_str());
+            return false;
+        }
+        
+        if (comma == string::npos)
+            break;
+        start = comma + 1;
+    }
+    
+    return true;
+}
+
+int main(int argc, const char * argv[])
+{
+    static const char *structureShortNames[structureCount] = { "tree", "avl", "treap", "set", "map", "treemap", "btree",
+                                                               "compact", "persistent", "frozen",
+                                                               "frozenbtree" };
+    BenchmarkOptions options;
+    
+    options.minSize = 1000;
+    options.maxSize = 1000000;
+    options.zipfExponent = 0.99;
+    options.seed = 1;
+    options.dictionary = nullptr;
+    options.readers = 0;
+    for (int i = 0 ; i < workloadCount ; i++) options.runWorkload[i] = true;
+    for (int i = 0 ; i < structureCount ; i++) options.runStructure[i] = true;
+    
+    for (int i = 1 ; i < argc ; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc ? argv[i + 1] : nullptr);
+        
+        if (strcmp(arg, "--help") == 0)
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        
+        if (value == nullptr)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        
+        if (strcmp(arg, "--min-size") == 0)
+            options.minSize = (size_t)strtod(value, nullptr);
+        else if (strcmp(arg, "--max-size") == 0)
+            options.maxSize = (size_t)strtod(value, nullptr);
+        else if (strcmp(arg, "--zipf") == 0)
+            options.zipfExponent = strtod(value, nullptr);
+        else if (strcmp(arg, "--seed") == 0)
+            options.seed = (unsigned int)strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--dictionary") == 0)
+            options.dictionary = value;
+        else if (strcmp(arg, "--readers") == 0)
+            options.readers = (unsigned int)strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--workloads") == 0)
+        {
+            if (!parseList(value, workloadNames, nullptr, workloadCount, options.runWorkload))
+                return 1;
+        }
+        else if (strcmp(arg, "--structures") == 0)
+        {
+            if (!parseList(value, structureNames, structureShortNames, structureCount, options.runStructure))
+                return 1;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    // Key indices are 32 bits
+    if (options.minSize < 1 || options.maxSize > 0xffffffffULL || options.minSize > options.maxSize)
+    {
+        fprintf(stderr, "Sizes have to be between 1 and 2^32 - 1\n");
+        return 1;
+    }
+    
+    if (options.dictionary != nullptr)
+    {
+        printf("%-10s%80s %10s %10s %12s\n", "ingest", "", "words", "peak RSS", "struct RSS");
+        
+        for (int method = 0 ; method < ingestCount ; method++)
+        {
+            RunResult result;
+            
+            printf("%-10s", ingestNames[method]);
+            
+            if (!runInChild([&]() { return runIngest((IngestMethod)method, options.dictionary, options); }, result))
+            {
+                printf("  failed\n");
+                continue;
+            }
+            
+            printPhase("load", result.build);
+            printPhase("query", result.query);
+            printf(" %10zu %7.1f MB %9.1f MB\n",
+                   result.finalSize,
+                   result.peakRssKB / 1024.0,
+                   (result.peakRssKB - result.baselineRssKB) / 1024.0);
+        }
+        
+        runSampling(options.dictionary, options);
+        
+        return 0;
+    }
+    
+    if (options.readers > 0)
+    {
+        KeySet keys(options.maxSize < 2 ? 2 : options.maxSize, options.seed);
+        
+        bool allFound = true;
+        
+        printf("%zu keys, one write per %llu lookups\n", keys.size(), lookupsPerWrite);
+        
+        for (unsigned int readerCount = 1 ; readerCount <= options.readers ; readerCount *= 2)
+        {
+            allFound &= runConcurrent(keys, readerCount, false, options.seed);
+            allFound &= runConcurrent(keys, readerCount, true, options.seed);
+        }
+        
+        return (allFound ? 0 : 1);
+    }
+    
+    printf("%-8s %10s %-10s%80s %10s %10s %12s\n",
+           "workload", "n", "structure", "", "final size", "peak RSS", "struct RSS");
+    
+    for (int workload = 0 ; workload < workloadCount ; workload++)
+    {
+        if (!options.runWorkload[workload])
+            continue;
+        
+        for (size_t n = options.minSize ; n <= options.maxSize ; n *= 10)
+        {
+            for (int structure = 0 ; structure < structureCount ; structure++)
+            {
+                if (!options.runStructure[structure])
+                    continue;
+                
+                RunResult result;
+                
+                printf("%-8s %10zu %-10s", workloadNames[workload], n, structureNames[structure]);
+                
+                if (!runInChild([&]() { return benchmarkWorkload((Workload)workload, (Structure)structure, n, options); }, result))
+                {
+                    printf("  failed (out of memory, or a check failed)\n");
+                    continue;
+                }
+                
+                printPhase("build", result.build);
+                printPhase("query", result.query);
+                printf(" %10zu %7.1f MB %9.1f MB\n",
+                       result.finalSize,
+                       result.peakRssKB / 1024.0,
+                       (result.peakRssKB - result.baselineRssKB) / 1024.0);
+            }
+        }
+    }
+    
+    return 0;
+}
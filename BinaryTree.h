@@ -13,27 +13,374 @@
 #include <assert.h>
 #include <iostream>
 #include <cstdlib>
+#include <iterator>
+#include <utility>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
 
 #include "TreeNode.h"
 #include "NodeWrap.h"
+#include "NodeArena.h"
+#include "TreeCounters.h"
+#include "EpochReclaim.h"
 #include "debugprintf.h"
+
+// #define VISUALIZE_ERRORS  // render the broken tree with Graphviz before asserting
+#ifdef VISUALIZE_ERRORS
 #include "visualizer.h"
+#endif
 
 using namespace std;
 
-template <typename btNodeTypeT>
+/// Lookups turn their key into the node type's Probe once up front, if it has one
+/// and the key converts to it (see StringNode::Probe), rather than redoing that
+/// work at every node on the way down.  Otherwise the key is used as is.
+template <typename NodeT, typename KeyT, typename = void>
+struct probeFor
+{
+    typedef const KeyT &type;
+};
+
+template <typename NodeT, typename KeyT>
+struct probeFor<NodeT, KeyT,
+                typename std::enable_if<std::is_constructible<typename NodeT::Probe, const KeyT &>::value>::type>
+{
+    typedef typename NodeT::Probe type;
+};
+
+/// Shape of a tree, kept up to date as the tree changes (see BinaryTree::stats()),
+/// so it's cheap enough to poll.  Depths count edges from the root (root is depth 0),
+/// heights count levels.
+///
+/// How much is known exactly depends on the balance policy.  The node count always
+/// is.  A red-black tree tracks its black height, which pins the height down: every
+/// root-to-null path has blackHeight black nodes and at most as many red ones, and
+/// no tree with n nodes can be shorter than log2(n+1) levels.  An AVL tree knows its
+/// height outright; a treap only has the trivial bounds.  So the height and leaf
+/// depth figures are bounds.
+struct TreeStats
+{
+    size_t nodeCount;
+    unsigned int blackHeight;        // black nodes on every path from the root down to a null (red-black only, else 0)
+    unsigned int minHeight;          // height is at least this...
+    unsigned int maxHeight;          // ...and at most this
+    unsigned int minLeafDepth;       // no leaf is shallower than this
+    unsigned int maxLeafDepth;       // or deeper than this
+};
+
+template <typename btNodeType, typename BalancePolicy>
+class FrozenTree;
+template <typename btNodeType, typename BalancePolicy>
+class FrozenBTree;
+
+/// The default balance policy, see RedBlackBalance.h (included at the bottom)
+class RedBlackBalance;
+
+/**
+ Binary search tree of btNodeTypeT nodes (see TreeNode for what a node type provides),
+ kept balanced by BalancePolicyT.
+ 
+ The tree does the searching, linking, rotating and bookkeeping; the policy decides
+ when to rotate, and keeps whatever it needs in each node's color and balanceInfo.
+ RedBlackBalance (the default) keeps the tree within 2 log2(n) levels with at most
+ two rotations per insert; AVLBalance (AVLBalance.h) keeps it within about
+ 1.44 log2(n), for lookup heavy use, at the price of more rotations; TreapBalance
+ (TreapBalance.h) keeps it balanced in expectation with random priorities, and only
+ ever touches the path under a change.  Each one checks its own invariants in
+ verifyTree.
+ **/
+template <typename btNodeTypeT, typename BalancePolicyT = RedBlackBalance>
 class BinaryTree
 {
     typedef btNodeTypeT btNodeType;
+    typedef BalancePolicyT BalancePolicy;
+    
+    // The policy does its work through the tree's private rotate, root and counters
+    friend BalancePolicyT;
     
 public:
+    /// Bidirectional in-order iterator.  Stepping follows the parent links
+    /// (see TreeNode::nextNode), so it's O(1) amortized and carries no stack.
+    /// end() is a null node; decrementing it gets you the last node in the tree.
+    template <typename valueType>
+    class treeIterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef valueType value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef valueType *pointer;
+        typedef valueType &reference;
+        
+        treeIterator() : currentNode(nullptr), theTree(nullptr)
+        {
+            
+        }
+        
+        treeIterator(valueType *node, const BinaryTree *tree) : currentNode(node), theTree(tree)
+        {
+            
+        }
+        
+        /// iterator converts to const_iterator, but not the other way around
+        operator treeIterator<const valueType>() const
+        {
+            return treeIterator<const valueType>(currentNode, theTree);
+        }
+        
+        reference operator*() const
+        {
+            return *currentNode;
+        }
+        
+        pointer operator->() const
+        {
+            return currentNode;
+        }
+        
+        pointer getNode() const
+        {
+            return currentNode;
+        }
+        
+        treeIterator &operator++()
+        {
+            assert(currentNode != nullptr);  // can't go past end()
+            currentNode = static_cast<valueType *>(const_cast<TreeNode *>(static_cast<const TreeNode *>(currentNode))->nextNode());
+            return *this;
+        }
+        
+        treeIterator operator++(int)
+        {
+            treeIterator before(*this);
+            ++(*this);
+            return before;
+        }
+        
+        treeIterator &operator--()
+        {
+            if (currentNode == nullptr)
+            {
+                assert(theTree != nullptr && theTree->treeRoot != nullptr);
+                currentNode = static_cast<valueType *>(theTree->treeRoot->rightMost());
+            }
+            else
+            {
+                currentNode = static_cast<valueType *>(const_cast<TreeNode *>(static_cast<const TreeNode *>(currentNode))->prevNode());
+            }
+            return *this;
+        }
+        
+        treeIterator operator--(int)
+        {
+            treeIterator before(*this);
+            --(*this);
+            return before;
+        }
+        
+        bool operator==(const treeIterator &rhs) const
+        {
+            return currentNode == rhs.currentNode;
+        }
+        
+        bool operator!=(const treeIterator &rhs) const
+        {
+            return currentNode != rhs.currentNode;
+        }
+        
+    private:
+        valueType *currentNode;
+        const BinaryTree *theTree;
+    };
+    
+    typedef treeIterator<btNodeType> iterator;
+    typedef treeIterator<const btNodeType> const_iterator;
+    
+    /**
+     A reader thread's handle on the tree, for lookups without a lock while one
+     other thread, the writer, keeps changing it.  Call enableConcurrentReaders
+     before making any, and give each reader thread its own.
+     
+     Lookups happen inside a Pin, and what they find is good until the Pin goes
+     away: the writer can erase a node at any time, but doesn't free it while a
+     reader could still be holding it (see EpochDomain).  Readers only ever look
+     at keys and child links, so that's all that's safe to look at; a MapNode's
+     value can be changed under you.
+     
+     A rotation or erase can move a key out from under a reader on its way down.
+     That only ever makes a lookup miss, never find the wrong thing, so a miss is
+     double checked against the tree's structure version (see beginMove) and the
+     lookup tried again if anything moved in the meantime.  Plain inserts don't
+     move anything: the new node is complete before it's linked in (publishLink),
+     so a reader either sees all of it or misses it, fair and square.
+     **/
+    class Reader
+    {
+    public:
+        explicit Reader(const BinaryTree &tree) : theTree(tree)
+        {
+            assert(tree.epochs != nullptr);  // no enableConcurrentReaders
+            slot = tree.epochs->join();
+            assert(slot != EpochDomain::noSlot);  // more readers than it allowed for
+        }
+        
+        ~Reader()
+        {
+            theTree.epochs->leave(slot);
+        }
+        
+        /// Keeps the nodes a reader finds from being freed, while it's around
+        class Pin
+        {
+        public:
+            explicit Pin(const Reader &reader) : pinned(reader)
+            {
+                pinned.theTree.epochs->enter(pinned.slot);
+            }
+            
+            ~Pin()
+            {
+                pinned.theTree.epochs->exit(pinned.slot);
+            }
+            
+        private:
+            Pin(const Pin &) = delete;
+            Pin &operator=(const Pin &) = delete;
+            
+            const Reader &pinned;
+        };
+        
+        /// Same as BinaryTree::find.  Only call it with a Pin held.
+        template <typename KeyT>
+        const btNodeType *find(const KeyT &key) const;
+        
+        template <typename KeyT>
+        bool contains(const KeyT &key) const
+        {
+            Pin pin(*this);
+            return find(key) != nullptr;
+        }
+        
+    private:
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+        
+        const BinaryTree &theTree;
+        unsigned int slot;
+    };
+    
+    /// How much checking the tree does on itself after each change (addNode, erase,
+    /// bulk builds).  verifyTree walks the whole tree, so checking it on every change
+    /// makes building a tree O(n^2); the cheaper levels are there so we can leave
+    /// checking on without paying for that.
+    enum ValidationLevel
+    {
+        validateOff,        // no checking at all
+        validatePath,       // local checks on the path the last change touched, O(log n)
+        validateSampled,    // full verifyTree every sampleInterval changes
+        validateFull        // full verifyTree after every change
+    };
+    
     BinaryTree()
     {
         treeRoot =  nullptr;
+        freeNodes = nullptr;
+        externalNodes = 0;
+        lastFixupLevels = 0;
+        lastTouchedNode = nullptr;
+        nodeCount = 0;
+        nextReclaim = reclaimBatch;
+        structureVersion.store(0, std::memory_order_relaxed);
+#ifdef NDEBUG
+        validationLevel = validateOff;
+#else
+        validationLevel = validateFull;
+#endif
+        sampleInterval = 1000;
+        changesSinceCheck = 0;
+        validationChecks = 0;
+        validationNanoseconds = 0;
+#ifdef TREE_COUNTERS
+        opNesting = 0;
+#endif
     }
     ~BinaryTree();
     
-    void addNode(btNodeType *node);
+    /// Build a node in the tree's arena.  The arguments go to btNodeType's arena
+    /// constructor after the arena itself, e.g. createNode("word") for a StringNode.
+    /// The node still has to be added with addNode.
+    template <typename... Args>
+    btNodeType *createNode(Args&&... args);
+    
+    /// Add a node to the tree, which takes ownership of it.  Nodes can come from
+    /// createNode, or be allocated with new.  Returns the node that holds the key
+    /// afterwards: node itself, or if the key was already there, the node that
+    /// already had it, in which case node is thrown away.
+    btNodeType *addNode(btNodeType *node);
+    
+    /// Look for key, and only if it isn't there, build a node from key and args
+    /// (see createNode) and add it.  Returns the node holding key, and whether it's
+    /// a new one.  Either way the node can be changed in place (its value, for a
+    /// MapNode, not its key), so this does a find-then-modify in one search.
+    template <typename KeyT, typename... Args>
+    std::pair<btNodeType *, bool> try_emplace(const KeyT &key, Args&&... args);
+    
+    /// For MapNode trees: add key with value, or if key is already there, give
+    /// its node value instead.  Returns the same as try_emplace.
+    template <typename KeyT, typename ValueT>
+    std::pair<btNodeType *, bool> insert_or_assign(const KeyT &key, ValueT &&value);
+    
+    /// Build the whole tree in one go from elements that are already in sorted order,
+    /// in linear time, instead of addNode'ing them one by one.  The tree has to be
+    /// empty.  Elements can be btNodeType pointers, which are linked in as they are,
+    /// or keys, which go through createNode.  Duplicates are dropped: ones the tree
+    /// built itself are recycled, nodes you passed in stay yours.
+    template <typename IterT>
+    void buildFromSorted(IterT first, IterT last);
+    
+    /// Same, for elements in any order.  They're sorted first (unless they turn
+    /// out to be sorted already), so this one is O(n log n).
+    template <typename IterT>
+    void buildFromUnsorted(IterT first, IterT last);
+    
+    /// Remove the node holding key, if there is one.  Returns the number of
+    /// nodes removed (0 or 1).  The tree owns its nodes, so the node is freed.
+    template <typename KeyT>
+    size_t erase(const KeyT &key);
+    
+    /// Remove a node that's already in this tree, and free it
+    void erase(btNodeType *node);
+    
+    /// Let other threads look things up through a Reader while this one keeps
+    /// changing the tree: one writer, any number of readers, none of them locking.
+    /// Call it before starting them; maxReaders is how many Readers there can be at
+    /// once.  From then on an erased node isn't freed until no reader can still be
+    /// looking at it, see reclaim.
+    void enableConcurrentReaders(unsigned int maxReaders = EpochDomain::defaultMaxReaders)
+    {
+        assert(epochs == nullptr);
+        epochs.reset(new EpochDomain(maxReaders));
+    }
+    
+    bool hasConcurrentReaders() const
+    {
+        return epochs != nullptr;
+    }
+    
+    /// Free the erased nodes no reader can still be looking at.  Erasing does this
+    /// every reclaimBatch nodes; a writer that's gone quiet can call it to catch up.
+    /// Returns the number still waiting.
+    size_t reclaim();
+    
+    /// The tree's balance policy, e.g. to seed a TreapBalance
+    BalancePolicy &getBalancePolicy()
+    {
+        return balancer;
+    }
     
     /// Identify a node as the root node
     bool isRoot(btNodeType *node)
@@ -44,7 +391,7 @@ public:
     void makeRoot(btNodeType *newRoot)
     {
         assert(newRoot != nullptr);
-        treeRoot = newRoot;
+        publishLink(treeRoot, newRoot);
         treeRoot->setToBlack();
     }
     
@@ -53,6 +400,124 @@ public:
         return treeRoot;
     }
     
+    /// Look up a key without building a probe node.  KeyT can be anything
+    /// btNodeType::compareKey() accepts, e.g. const char *, string_view or string
+    /// for StringNode.  Returns the node holding the key, or nullptr.
+    template <typename KeyT>
+    btNodeType *find(const KeyT &key) const;
+    
+    template <typename KeyT>
+    bool contains(const KeyT &key) const
+    {
+        return find(key) != nullptr;
+    }
+    
+    iterator begin()
+    {
+        return iterator(treeRoot ? nodeCast<btNodeType>(treeRoot->leftMost()) : nullptr, this);
+    }
+    
+    iterator end()
+    {
+        return iterator(nullptr, this);
+    }
+    
+    const_iterator begin() const
+    {
+        return const_iterator(treeRoot ? nodeCast<btNodeType>(treeRoot->leftMost()) : nullptr, this);
+    }
+    
+    const_iterator end() const
+    {
+        return const_iterator(nullptr, this);
+    }
+    
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+    
+    const_iterator cend() const
+    {
+        return end();
+    }
+    
+    /// Range scans.  lower_bound is the first node whose key isn't less than key,
+    /// upper_bound the first node whose key is greater.  Either may be end().
+    template <typename KeyT>
+    iterator lower_bound(const KeyT &key)
+    {
+        return iterator(boundNode(key, false), this);
+    }
+    
+    template <typename KeyT>
+    iterator upper_bound(const KeyT &key)
+    {
+        return iterator(boundNode(key, true), this);
+    }
+    
+    template <typename KeyT>
+    std::pair<iterator, iterator> equal_range(const KeyT &key)
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+    
+    template <typename KeyT>
+    const_iterator lower_bound(const KeyT &key) const
+    {
+        return const_iterator(boundNode(key, false), this);
+    }
+    
+    template <typename KeyT>
+    const_iterator upper_bound(const KeyT &key) const
+    {
+        return const_iterator(boundNode(key, true), this);
+    }
+    
+    template <typename KeyT>
+    std::pair<const_iterator, const_iterator> equal_range(const KeyT &key) const
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+    
+    /// Number of nodes in the tree
+    size_t size() const
+    {
+        return nodeCount;
+    }
+    
+    /// Tree shape, O(1).  See TreeStats.
+    TreeStats stats() const;
+    
+    /// Read-only copy of the tree laid out for fast lookups, see FrozenTree.h
+    /// (which has to be included to use this).  It points back at this tree's
+    /// nodes, so it's only good until the tree changes.
+    FrozenTree<btNodeType, BalancePolicy> freeze() const;
+    
+    /// Same idea as a 17 way B+ tree with cache line nodes, see FrozenBTree.h
+    FrozenBTree<btNodeType, BalancePolicy> freezeBTree() const;
+    
+    /// Order statistics.  select(k) is the k-th smallest node (counting from zero),
+    /// or nullptr if there aren't that many.  rank(key) is the number of nodes whose
+    /// key is less than key, and countInRange(lo, hi) the number in [lo, hi].
+    /// All O(log n) with SUBTREE_SIZES defined (see TreeNode.h), O(n) otherwise.
+    btNodeType *select(size_t k) const;
+    
+    template <typename KeyT>
+    size_t rank(const KeyT &key) const
+    {
+        return countBelow(key, false);
+    }
+    
+    template <typename KeyT>
+    size_t countInRange(const KeyT &lo, const KeyT &hi) const
+    {
+        size_t upTo = countBelow(hi, true);
+        size_t below = countBelow(lo, false);
+        
+        return (upTo > below ? upTo - below : 0);
+    }
+    
     void dumpSortedTree(const TreeNode *node);
     void dumpPreOrderTree(const TreeNode *node);
     
@@ -72,6 +537,58 @@ public:
         
     }
     
+    /// Pick how much self checking to do (see ValidationLevel).  sampleInterval is
+    /// only used by validateSampled.  Debug builds default to validateFull, release
+    /// (NDEBUG) builds to validateOff.
+    void setValidation(ValidationLevel level, unsigned int interval = 1000)
+    {
+        validationLevel = level;
+        sampleInterval = (interval > 0 ? interval : 1);
+        changesSinceCheck = 0;
+    }
+    
+    ValidationLevel getValidationLevel() const
+    {
+        return validationLevel;
+    }
+    
+    /// Number of checks run, and the time spent in them
+    unsigned long getValidationChecks() const
+    {
+        return validationChecks;
+    }
+    
+    unsigned long long getValidationNanoseconds() const
+    {
+        return validationNanoseconds;
+    }
+    
+    /// How many levels the last addNode's rebalancing had to look at
+    unsigned int getLastFixupLevels() const
+    {
+        return lastFixupLevels;
+    }
+    
+    /// Where createNode's nodes and keys live: bytes reserved, used, and given back
+    /// by erased keys but not reused yet
+    const NodeArena &getArena() const
+    {
+        return nodeArena;
+    }
+    
+#ifdef TREE_COUNTERS
+    /// Snapshot of the hot path counters and latency histograms, see TreeCounters.h
+    TreeCounters getCounters() const
+    {
+        return counters;
+    }
+    
+    void resetCounters()
+    {
+        counters.reset();
+    }
+#endif
+    
     void getMinMaxDepth(unsigned int &minDepth, unsigned int &maxDepth)
     {
         // Should probably be able to do this as we build the tree
@@ -81,15 +598,83 @@ public:
     
     
 private:
+    BinaryTree(const BinaryTree &) = delete;
+    BinaryTree &operator=(const BinaryTree &) = delete;
+    
+    /// Arena slots of erased nodes, reused by createNode
+    struct FreeSlot
+    {
+        FreeSlot *next;
+    };
+    
     btNodeType *treeRoot;
+    NodeArena nodeArena;
+    FreeSlot *freeNodes;
+    size_t externalNodes;   // nodes in the tree that were NOT built by createNode
+    
+    /// An erased node a Reader might still be looking at, and when it was erased
+    struct RetiredNode
+    {
+        btNodeType *node;
+        uint64_t epoch;
+    };
+    
+    static const size_t reclaimBatch = 64;
+    
+    std::unique_ptr<EpochDomain> epochs;     // only with enableConcurrentReaders
+    std::vector<RetiredNode> retiredNodes;   // oldest first
+    size_t nextReclaim;                      // reclaim when there are this many
+    std::atomic<unsigned long> structureVersion;
+    
+    void releaseNode(btNodeType *node);
+    void retireNode(btNodeType *node);
+    
+    /// Bracket anything that moves nodes already in the tree (rotating, unlinking).
+    /// The version is odd while it's going on, and ends up changed, which is what
+    /// Reader::find checks a miss against.  Only the writer changes it, so plain
+    /// loads and stores will do.
+    void beginMove()
+    {
+        structureVersion.store(structureVersion.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    
+    void endMove()
+    {
+        structureVersion.store(structureVersion.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    
+    btNodeType *nodeFrom(btNodeType *node)
+    {
+        return node;
+    }
+    
+    template <typename KeyT>
+    btNodeType *nodeFrom(const KeyT &key)
+    {
+        return createNode(key);
+    }
+    
+    static bool nodeLess(const btNodeType *lhs, const btNodeType *rhs)
+    {
+        return rhs->compare(lhs) < 0;
+    }
+    
+    void linkNode(btNodeType *node, btNodeType *parent, TreeNode::NodeDirection whichSide);
+    void linkSorted(std::vector<btNodeType *> &nodes);
+    btNodeType *linkSortedRange(std::vector<btNodeType *> &nodes, size_t lo, size_t hi,
+                                unsigned int depth, unsigned int lastDepth);
     btNodeType *findNode(btNodeType *node, bool &found);
     btNodeType *searchNode(btNodeType * node, btNodeType * root,
                            bool &found);
-    void reBalance(btNodeType *wNode, TreeNode::NodeDirection dir);
-    btNodeType * doRotation(btNodeType *node,
-                            TreeNode::NodeDirection childDir);
-    btNodeType * doDoubleRotation(btNodeType *node,
-                            TreeNode::NodeDirection childDir);
+    unsigned int lastFixupLevels;
+    btNodeType *rotate(btNodeType *node, TreeNode::NodeDirection rotateDir);
+    template <typename KeyT>
+    btNodeType *boundNode(const KeyT &key, bool upper) const;
+    template <typename KeyT>
+    size_t countBelow(const KeyT &key, bool inclusive) const;
+    void unlinkNode(btNodeType *node);
+    void transplant(btNodeType *oldNode, btNodeType *newNode);
     void drillDownToMaxDepth(btNodeType *node, unsigned int &minDepth, unsigned int &maxDepth)
     {
         if (node == nullptr) return;
@@ -103,45 +688,288 @@ private:
                 minDepth = node->getDepth();
         }
         
-        drillDownToMaxDepth(dynamic_cast<btNodeType *>(node->leftNode),  minDepth, maxDepth);
-        drillDownToMaxDepth(dynamic_cast<btNodeType *>(node->rightNode), minDepth, maxDepth);
+        drillDownToMaxDepth(nodeCast<btNodeType>(node->leftNode),  minDepth, maxDepth);
+        drillDownToMaxDepth(nodeCast<btNodeType>(node->rightNode), minDepth, maxDepth);
         
     }
     
     void dumpNodeInfo(const btNodeType *node)
     {
-        btNodeType *leftNodeName = dynamic_cast<btNodeType *>(node->leftNode);
-        btNodeType *rightNodeName = dynamic_cast<btNodeType *>(node->rightNode);
-        btNodeType *parentNodeName = dynamic_cast<btNodeType *>(node->parentNode);
-        
-        cout << "Node: " << (void *)((TreeNode *)node) << " value '" << node->getCValue() << "', level:" << node->getDepth()
+        cout << "Node: " << (void *)((TreeNode *)node) << " value '" << describeNode(node) << "', level:" << node->getDepth()
         << " (" << (node->isRed() ? "red" : "black") << ")" << endl;
-        cout << "\tParent Node: " << (void *)((TreeNode *)(node->parentNode)) <<  " [" << (node->parentNode ? parentNodeName->getCValue() : "NULL") << "]" << endl;
-        cout << "\t\tLeft Node: " << (void *)((TreeNode *)(node->leftNode)) << " [" << (node->leftNode ? leftNodeName->getCValue() : "NULL") << "]" << endl;
-        cout << "\t\tRight Node: " << (void *)((TreeNode *)(node->rightNode)) << " [" << (node->rightNode ? rightNodeName->getCValue() : "NULL") << "]" << endl << endl;
+        cout << "\tParent Node: " << (void *)((TreeNode *)(node->parentNode)) <<  " [" << describeNode(nodeCast<btNodeType>(node->parentNode)) << "]" << endl;
+        cout << "\t\tLeft Node: " << (void *)((TreeNode *)(node->leftNode)) << " [" << describeNode(nodeCast<btNodeType>(node->leftNode)) << "]" << endl;
+        cout << "\t\tRight Node: " << (void *)((TreeNode *)(node->rightNode)) << " [" << describeNode(nodeCast<btNodeType>(node->rightNode)) << "]" << endl << endl;
     }
     
     unsigned int verifyTree(const btNodeType *theRoot);
+    bool verifyLocal(const btNodeType *node);
+    bool verifyPath(const btNodeType *node);
+    bool verifyStats();
+    void validateAfterChange(btNodeType *touched);
+    
+    btNodeType *lastTouchedNode;   // lowest node the last erase changed
+    size_t nodeCount;
+    BalancePolicy balancer;        // and whatever it keeps track of, see TreeStats
+    ValidationLevel validationLevel;
+    unsigned int sampleInterval;
+    unsigned int changesSinceCheck;
+    unsigned long validationChecks;
+    unsigned long long validationNanoseconds;
+    
+#ifdef TREE_COUNTERS
+    mutable TreeCounters counters;
+    mutable unsigned int opNesting;   // so nested operations only get counted once
+#endif
 };
 
 
 
-// This is the tricky bit, since we want a balanced binary tree
-template <typename btNodeType>
-void BinaryTree<btNodeType>::addNode(btNodeType *node)
+// Tear down the whole tree.  If every node came out of the arena and the node
+// type doesn't need its destructor run, there's nothing to do node by node:
+// the arena hands its slabs back when it goes away.
+template <typename btNodeType, typename BalancePolicy>
+BinaryTree<btNodeType, BalancePolicy>::~BinaryTree()
 {
-    debugPrintf2("Adding node %p, with value '%s'\n", node, node->getCValue());
+    // No readers left by now, so nothing erased needs to wait any more
+    for (RetiredNode &retired : retiredNodes)
+        releaseNode(retired.node);
+    retiredNodes.clear();
     
-    if (treeRoot == nullptr)
+    if (externalNodes == 0 && btNodeType::trivialArenaTeardown)
+        return;
+    
+    // Otherwise, visit every node without recursing or needing a stack: rotate
+    // left children up until the node at the top has no left child, then it can go
+    TreeNode *node = treeRoot;
+    
+    while (node != nullptr)
     {
-        debugPrintf("\tadding as root\n");
-        treeRoot = node;
-        treeRoot->setToBlack();
+        if (node->leftNode != nullptr)
+        {
+            TreeNode *left = node->leftNode;
+            node->leftNode = left->rightNode;
+            left->rightNode = node;
+            node = left;
+        }
+        else
+        {
+            TreeNode *right = node->rightNode;
+            btNodeType *doomed = nodeCast<btNodeType>(node);
+            
+            if (nodeArena.owns(doomed))
+                doomed->~btNodeType();
+            else
+                delete doomed;
+            
+            node = right;
+        }
+    }
+    
+    treeRoot = nullptr;
+}
+
+template <typename btNodeType, typename BalancePolicy>
+template <typename... Args>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::createNode(Args&&... args)
+{
+    void *slot;
+    
+    if (freeNodes != nullptr)
+    {
+        slot = freeNodes;
+        freeNodes = freeNodes->next;
+    }
+    else
+    {
+        slot = nodeArena.allocate(sizeof(btNodeType), alignof(btNodeType));
+    }
+    
+    return new (slot) btNodeType(nodeArena, std::forward<Args>(args)...);
+}
+
+// Get rid of a node that's no longer in the tree.  Arena nodes go on the free
+// list for createNode to reuse, and their key bytes back to the arena's.
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::releaseNode(btNodeType *node)
+{
+    if (nodeArena.owns(node))
+    {
+        node->releaseArenaBytes(nodeArena);
+        node->~btNodeType();
         
+        FreeSlot *slot = reinterpret_cast<FreeSlot *>(node);
+        slot->next = freeNodes;
+        freeNodes = slot;
+    }
+    else
+    {
+        delete node;
+        externalNodes--;
+    }
+}
+
+// Same, for a node that's just been erased while Readers may be about.  It keeps
+// its key until no reader can still have it, see EpochDomain.
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::retireNode(btNodeType *node)
+{
+    RetiredNode retired;
+    
+    retired.node = node;
+    retired.epoch = epochs->getEpoch();
+    retiredNodes.push_back(retired);
+    
+    if (retiredNodes.size() >= nextReclaim)
+        nextReclaim = reclaim() + reclaimBatch;
+}
+
+template <typename btNodeType, typename BalancePolicy>
+size_t BinaryTree<btNodeType, BalancePolicy>::reclaim()
+{
+    if (epochs == nullptr)
+        return 0;
+    
+    // Something erased has to wait for the epoch to move on twice; with no reader
+    // in the way, it can do both now
+    if (epochs->tryAdvance())
+        epochs->tryAdvance();
+    
+    // They went in oldest first, so everything that can go is at the front
+    size_t freed = 0;
+    
+    while (freed < retiredNodes.size() && epochs->isQuiescent(retiredNodes[freed].epoch))
+        releaseNode(retiredNodes[freed++].node);
+    
+    retiredNodes.erase(retiredNodes.begin(), retiredNodes.begin() + freed);
+    
+    return retiredNodes.size();
+}
+
+template <typename btNodeType, typename BalancePolicy>
+template <typename IterT>
+void BinaryTree<btNodeType, BalancePolicy>::buildFromSorted(IterT first, IterT last)
+{
+    std::vector<btNodeType *> nodes;
+    
+    for ( ; first != last ; ++first)
+        nodes.push_back(nodeFrom(*first));
+    
+    linkSorted(nodes);
+}
+
+template <typename btNodeType, typename BalancePolicy>
+template <typename IterT>
+void BinaryTree<btNodeType, BalancePolicy>::buildFromUnsorted(IterT first, IterT last)
+{
+    std::vector<btNodeType *> nodes;
+    
+    for ( ; first != last ; ++first)
+        nodes.push_back(nodeFrom(*first));
+    
+    if (!std::is_sorted(nodes.begin(), nodes.end(), nodeLess))
+        std::sort(nodes.begin(), nodes.end(), nodeLess);
+    
+    linkSorted(nodes);
+}
+
+/**
+ Turn a sorted list of nodes into a balanced tree, all at once.
+ 
+ Taking the middle node as the root and recursing on each half gives a tree where
+ every level is full except maybe the last one, i.e. with n nodes, all the levels
+ above depth floor(log2(n+1)) are full.  That's balanced by any policy's standards;
+ the policy only has to set up its state for it, node by node (see builtNode).  For
+ red-black, every node above that depth is black, and the ones on the partial last
+ level (if there is one) red: every path from the root then goes through the same
+ number of black nodes, and the red nodes are all leaves hanging off black ones.
+ **/
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::linkSorted(std::vector<btNodeType *> &nodes)
+{
+    assert(treeRoot == nullptr);  // only for building a tree from scratch
+    
+    // Drop duplicates, and make sure it really was sorted
+    size_t kept = 0;
+    
+    for (size_t i = 0 ; i < nodes.size() ; i++)
+    {
+        if (kept > 0 && nodes[kept - 1]->compare(nodes[i]) == 0)
+        {
+            if (nodeArena.owns(nodes[i]))
+                releaseNode(nodes[i]);
+            continue;
+        }
+        
+        assert(kept == 0 || nodeLess(nodes[kept - 1], nodes[i]));
+        nodes[kept++] = nodes[i];
+    }
+    nodes.resize(kept);
+    
+    if (nodes.empty())
         return;
+    
+    // Depth of the partial last level, if there is one (otherwise nothing's that deep)
+    unsigned int lastDepth = 0;
+    for (size_t full = nodes.size() + 1 ; full > 1 ; full >>= 1)
+        lastDepth++;
+    
+    // Readers only get to see it once it's all put together
+    btNodeType *root = linkSortedRange(nodes, 0, nodes.size(), 0, lastDepth);
+    root->parentNode = nullptr;
+    publishLink(treeRoot, root);
+    nodeCount = nodes.size();
+    
+    for (btNodeType *node : nodes)
+    {
+        if (!nodeArena.owns(node))
+            externalNodes++;
     }
     
-    node->setToRed();   // all nodes start out red except the root
+    validateAfterChange(treeRoot);
+}
+
+// Link nodes[lo, hi) into a subtree and return its root
+template <typename btNodeType, typename BalancePolicy>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::linkSortedRange(std::vector<btNodeType *> &nodes, size_t lo, size_t hi,
+                                                    unsigned int depth, unsigned int lastDepth)
+{
+    if (lo >= hi)
+        return nullptr;
+    
+    size_t mid = lo + (hi - lo) / 2;
+    btNodeType *node = nodes[mid];
+    
+    node->leftNode = linkSortedRange(nodes, lo, mid, depth + 1, lastDepth);
+    node->rightNode = linkSortedRange(nodes, mid + 1, hi, depth + 1, lastDepth);
+    
+    if (node->leftNode != nullptr) node->leftNode->parentNode = node;
+    if (node->rightNode != nullptr) node->rightNode->parentNode = node;
+    
+    node->setDepth(depth);
+#ifdef SUBTREE_SIZES
+    node->setSubtreeSize((unsigned int)(hi - lo));
+#endif
+    
+    // Children first, so the policy can work from theirs (and the root comes last)
+    balancer.builtNode(node, depth, lastDepth);
+    
+    return node;
+}
+
+// This is the tricky bit, since we want a balanced binary tree
+template <typename btNodeType, typename BalancePolicy>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::addNode(btNodeType *node)
+{
+    debugPrintf2("Adding node %p, with value '%s'\n", node, describeNode(node).c_str());
+    treeTimeOp(treeOpInsert);
+    
+    if (treeRoot == nullptr)
+    {
+        debugPrintf("\tadding as root\n");
+        linkNode(node, nullptr, NONE);
+        return node;
+    }
     
     // Step 1: search the tree to see where this node should go.
     //          If found is set to true in findNode, then the node
@@ -153,76 +981,145 @@ void BinaryTree<btNodeType>::addNode(btNodeType *node)
     
     if (found)
     {
-        debugPrintf2("Value '%s' found at node %p\n", node->getCValue(), foundNode);
-        return; // we found it, all done
+        debugPrintf2("Value '%s' found at node %p\n", describeNode(node).c_str(), foundNode);
+        
+        // We own it, and don't need it
+        if (nodeArena.owns(node))
+            releaseNode(node);
+        else
+            delete node;
+        
+        return foundNode; // we found it, all done
     }
     
     debugPrintf("Node not found in tree\n");
     
     // Step 2:  see if the branch we need to add to is available
     int compResult = foundNode->compare(node);
+    treeCount(counters.totalComparisons++);
     
     // if they're equal, we shouldn't be here
     assert(compResult != 0);
     
-    btNodeType * theNode;  // Set theNode to point to either the right or left child
-                           // of the foundNode, depending on its value.
-                           // Since the foundNode is supposed to be the leaf node
-                           // where we're going to add our new node, that child pointer
-                           // had better be null!
     TreeNode::NodeDirection whichSide;  // which side (left or right) node was added to
     
     if (compResult < 0)
     {
-        debugPrintf1("Adding '%s' to left node ", node->getCValue());
+        debugPrintf1("Adding '%s' to left node ", describeNode(node).c_str());
         whichSide = LEFT;
     }
     else
     {
-        debugPrintf1("Adding '%s' to right node ", node->getCValue());
-        whichSide = RIGHT;
+        debugPrintf1("Adding '%s' to right node ", describeNode(node).c_str());
+        whichSide = RIGHT;
+    }
+    
+    // If we haven't found the node, than the node returned from the search is guaranteed
+    // to have a null left or right branch, as approprite
+    assert(wFoundNode[whichSide] == nullptr);
+    
+    // Step 3:  If the branch is free, add the node as a new leaf
+    linkNode(node, foundNode, whichSide);
+    
+    return node;
+}
+
+template <typename btNodeType, typename BalancePolicy>
+template <typename KeyT, typename... Args>
+std::pair<btNodeType *, bool> BinaryTree<btNodeType, BalancePolicy>::try_emplace(const KeyT &key, Args&&... args)
+{
+    treeTimeOp(treeOpInsert);
+    
+    // Same walk as find, but remember where we fell off the tree
+    const TreeNode *current = treeRoot;
+    btNodeType *parent = nullptr;
+    TreeNode::NodeDirection whichSide = NONE;
+    typename probeFor<btNodeType, KeyT>::type probe(key);
+    
+    while (current != nullptr)
+    {
+        int compResult = nodeCast<btNodeType>(current)->compareKey(probe);
+        treeCount(counters.totalComparisons++);
+        
+        if (compResult == 0)
+            return std::make_pair(const_cast<btNodeType *>(nodeCast<btNodeType>(current)), false);
+        
+        parent = const_cast<btNodeType *>(nodeCast<btNodeType>(current));
+        whichSide = (compResult < 0 ? LEFT : RIGHT);
+        current = (compResult < 0 ? current->leftNode : current->rightNode);
     }
     
-    theNode = wFoundNode[whichSide];
+    // Only now that we know it's new do we build a node
+    btNodeType *node = createNode(key, std::forward<Args>(args)...);
     
-    // Note at this point, foundNode will be the parent (before rebalancing)
-    // of the new node
+    linkNode(node, parent, whichSide);
     
-    // If we haven't found the node, than the node returned from the search is guaranteed
-    // to have a null left or right branch, as approprite
-    assert(theNode == nullptr);
+    return std::make_pair(node, true);
+}
+
+template <typename btNodeType, typename BalancePolicy>
+template <typename KeyT, typename ValueT>
+std::pair<btNodeType *, bool> BinaryTree<btNodeType, BalancePolicy>::insert_or_assign(const KeyT &key, ValueT &&value)
+{
+    std::pair<btNodeType *, bool> result = try_emplace(key, std::forward<ValueT>(value));
     
-    // Step 3:  If the branch is free, add the node as a new leaf
+    // try_emplace only used value if it built a node
+    if (!result.second)
+        result.first->setMapped(std::forward<ValueT>(value));
+    
+    return result;
+}
+
+// Hang a new node off parent, on side whichSide, and rebalance.  With no parent,
+// the node becomes the root of what was an empty tree.
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::linkNode(btNodeType *node, btNodeType *parent, TreeNode::NodeDirection whichSide)
+{
+    if (!nodeArena.owns(node))
+        externalNodes++;
+    
+    nodeCount++;
+    
+    if (parent == nullptr)
+    {
+        assert(treeRoot == nullptr);
+        publishLink(treeRoot, node);
+        balancer.linkRoot(*this, node);
+        lastFixupLevels = 0;
+        return;
+    }
+    
+    // Splicing makes it red, as every node but the root starts out in a red-black tree
     if (whichSide == LEFT)
     {
-        foundNode->spliceNodeLeft(node);
-        debugPrintf3("%p, '%s' depth:%d\n", foundNode->leftNode, foundNode->getCValue(), foundNode->leftNode->getDepth());
+        parent->spliceNodeLeft(node);
+        debugPrintf3("%p, '%s' depth:%d\n", parent->leftNode, describeNode(parent).c_str(), parent->leftNode->getDepth());
     }
     else
     {
-        foundNode->spliceNodeRight(node);
-        debugPrintf3("%p, '%s' depth:%d\n", foundNode->rightNode, foundNode->getCValue(), foundNode->rightNode->getDepth());
+        parent->spliceNodeRight(node);
+        debugPrintf3("%p, '%s' depth:%d\n", parent->rightNode, describeNode(parent).c_str(), parent->rightNode->getDepth());
     }
     
-    // Rebalance from the new parent node
-    reBalance(foundNode, whichSide);
-
+    // Rebalance from the new node up
+    lastFixupLevels = balancer.afterInsert(*this, node);
+    
 #ifdef DEBUG_OUTPUT
     dumpPreOrderTree(getRoot());
 #endif
     
-    assert (verifyTree(getRoot()) != 0);
+    validateAfterChange(node);
 }
 
 // Search the tree from the root for a node with the same value as the passed
 // in node.  If found, the node is returned and the found parameter is set to true.
 // Otherwise, the node is returned that should be the parent of the node, should it be
 // added. To do this efficiently, we'll keep track of how deep each node is
-template <typename btNodeType>
-btNodeType *BinaryTree<btNodeType>::findNode(btNodeType *node, bool &found)
+template <typename btNodeType, typename BalancePolicy>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::findNode(btNodeType *node, bool &found)
 {
-    debugPrintf2("Searching for '%s' in node '%p'", node->getCValue(), node);
-    debugPrintf2(" starting at root '%s', node '%p'\n", treeRoot->getCValue(), treeRoot);
+    debugPrintf2("Searching for '%s' in node '%p'", describeNode(node).c_str(), node);
+    debugPrintf2(" starting at root '%s', node '%p'\n", describeNode(treeRoot).c_str(), treeRoot);
     return searchNode(node, treeRoot, found);
 }
 
@@ -230,178 +1127,280 @@ btNodeType *BinaryTree<btNodeType>::findNode(btNodeType *node, bool &found)
 // If such a node is found, the return value "found" is set to true, and a pointer to the
 // located node is returned.
 // If such a node is NOT found, then a pointer to the node off of which "node" should hang is returned.
-template <typename btNodeType>
-btNodeType *BinaryTree<btNodeType>::searchNode(btNodeType *node, btNodeType *root, bool &found)
+template <typename btNodeType, typename BalancePolicy>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::searchNode(btNodeType *node, btNodeType *root, bool &found)
 {
-    debugPrintf2("Searching for value '%s' from node %p...\n", node->getCValue(), (void *)root);
-    int compResult = root->compare(node);
-    
-    debugPrintf2("compare result with '%s' is %d...\n", root->getCValue(), compResult);
+    debugPrintf2("Searching for value '%s' from node %p...\n", describeNode(node).c_str(), (void *)root);
     
     found = false;
-    if (compResult == 0) // we found it!
+    
+    // Walk down the tree, no need to burn a stack frame per level
+    while (true)
     {
-        found = true;
-        debugPrintf("Found!\n");
-        return node;
+        int compResult = root->compare(node);
+        treeCount(counters.totalComparisons++);
+        
+        debugPrintf2("compare result with '%s' is %d...\n", describeNode(root).c_str(), compResult);
+        
+        if (compResult == 0) // we found it!
+        {
+            found = true;
+            debugPrintf("Found!\n");
+            return root;
+        }
+        
+        TreeNode::NodeDirection nodeDir = (compResult < 0 ? LEFT : RIGHT);
+        NodeWrap<btNodeType> wRoot(root);
+        debugPrintf1("\twNode[nodeDir] == %p\n", wRoot[nodeDir]);
+        if (wRoot[nodeDir] == nullptr)
+        {
+            return root;
+        }
+        
+        root = wRoot[nodeDir];
     }
+}
+
+// Key lookup from the root.  Same walk as searchNode, but compares the bare key
+// against each node so callers don't have to allocate a probe node
+template <typename btNodeType, typename BalancePolicy>
+template <typename KeyT>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::find(const KeyT &key) const
+{
+    treeTimeOp(treeOpLookup);
     
-    TreeNode::NodeDirection nodeDir = (compResult < 0 ? LEFT : RIGHT);
-    NodeWrap<btNodeType> wRoot(root);
-    debugPrintf1("\twNode[nodeDir] == %p\n", wRoot[nodeDir]);
-    if (wRoot[nodeDir] == nullptr)
+    // Every node in this tree is a btNodeType, so a static cast is safe here
+    const TreeNode *current = treeRoot;
+    typename probeFor<btNodeType, KeyT>::type probe(key);
+    
+    while (current != nullptr)
     {
-        return root;
+        int compResult = nodeCast<btNodeType>(current)->compareKey(probe);
+        treeCount(counters.totalComparisons++);
+        
+        if (compResult == 0)
+            return const_cast<btNodeType *>(nodeCast<btNodeType>(current));
+        
+        current = (compResult < 0 ? current->leftNode : current->rightNode);
     }
     
-    return searchNode(node, wRoot[nodeDir], found);
+    return nullptr;
 }
 
-// In-order tree traversal == sorted tree values
-template <typename btNodeType>
-void BinaryTree<btNodeType>::dumpSortedTree(const TreeNode *node)
+// Same walk as find, from a reader thread.  Every link is read the way the writer
+// publishes them, so the nodes on the way down are complete, and a miss only
+// counts if no node moved while we were looking.
+template <typename btNodeType, typename BalancePolicy>
+template <typename KeyT>
+const btNodeType *BinaryTree<btNodeType, BalancePolicy>::Reader::find(const KeyT &key) const
 {
-    // do the left branch, this node, and the right branch
-    // should get sorted list
-    if (node == nullptr) return;
-    
-    dumpSortedTree(node->leftNode);
+    typename probeFor<btNodeType, KeyT>::type probe(key);
     
-    dumpNodeInfo(dynamic_cast<const btNodeType *>(node));
-    
-    dumpSortedTree(node->rightNode);
+    while (true)
+    {
+        unsigned long version = theTree.structureVersion.load(std::memory_order_acquire);
+        const TreeNode *current = followLink(theTree.treeRoot);
+        
+        while (current != nullptr)
+        {
+            int compResult = nodeCast<btNodeType>(current)->compareKey(probe);
+            
+            if (compResult == 0)
+                return nodeCast<btNodeType>(current);
+            
+            current = followLink(compResult < 0 ? current->leftNode : current->rightNode);
+        }
+        
+        // Anything we saw moving shows up as a new version (see beginMove)
+        std::atomic_thread_fence(std::memory_order_acquire);
+        
+        if ((version & 1) == 0 && theTree.structureVersion.load(std::memory_order_relaxed) == version)
+            return nullptr;
+    }
 }
 
-// Pre-order tree traversal gives us the root first, a little
-// easier to look at for debugging
-template <typename btNodeType>
-void BinaryTree<btNodeType>::dumpPreOrderTree(const TreeNode *node)
+// Shared walk for lower_bound and upper_bound.  Remember the last node where we
+// went left; that's the smallest node that's still >= key (or > key for upper)
+template <typename btNodeType, typename BalancePolicy>
+template <typename KeyT>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::boundNode(const KeyT &key, bool upper) const
 {
-    // do the left branch, this node, and the right branch
-    // should get sorted list
-    if (node == nullptr) return;
+    treeTimeOp(treeOpLookup);
     
-    dumpNodeInfo(dynamic_cast<const btNodeType *>(node));
+    const TreeNode *current = treeRoot;
+    const TreeNode *bound = nullptr;
+    typename probeFor<btNodeType, KeyT>::type probe(key);
     
-    dumpPreOrderTree(node->leftNode);
+    while (current != nullptr)
+    {
+        int compResult = nodeCast<btNodeType>(current)->compareKey(probe);
+        treeCount(counters.totalComparisons++);
+        
+        if (compResult < 0 || (compResult == 0 && !upper))
+        {
+            bound = current;
+            current = current->leftNode;
+        }
+        else
+        {
+            current = current->rightNode;
+        }
+    }
     
-    dumpPreOrderTree(node->rightNode);
+    return const_cast<btNodeType *>(nodeCast<btNodeType>(bound));
 }
 
-/**
- Here are the allowed node configurations:
- 
- 2-node:         Black
-                /    \
- 
- 3-node:        Black                       Black
-                /    \                      /     \
-                Red                                Red
-                /   \                               /  \
- 
- 4-node: (must be split!)
- Black
- /     \
- Red     Red
- /   \   /   \
- 
- All other configurations are invalid and need to be repaired
- 
- Governing rules are:
- 
- * A red node can't have a red node child. red nodes abstract the 2-3-4 tree so their
- children have to be black nodes
- * Since the leaves of a 2-3-4 tree are at the same level, the same has to be true of
- the black nodes in a red-black tree.  Red nodes aren't counted since they're "abstract" in
- the red-black tree sense, and a black node and its red children are one abstract 2-3-4 node.
- So... the number of black nodes on any path of a red-black tree must be the same.
- **/
-/// The argument node is the node at which we're rebalancing.  We only look locally at the current node,
-/// and its children (and maybe grandchildren in some cases)
-template <typename btNodeType>
-void BinaryTree<btNodeType>::reBalance(btNodeType *node, TreeNode::NodeDirection whichSide)
+template <typename btNodeType, typename BalancePolicy>
+TreeStats BinaryTree<btNodeType, BalancePolicy>::stats() const
 {
-    if (node == nullptr) return;
-    bool treeChanged = false;
+    TreeStats treeStats;
     
-    // First, if we're at the root, we're done
-    // if (isRoot(node)) return;
+    treeStats.nodeCount = nodeCount;
+    treeStats.blackHeight = 0;
     
-    btNodeType *newNode = node;  // initialize here, so if nothing changes we'll rebalance up the
-                                 // tree starting from here
-    NodeWrap<btNodeType> wNode(node);
+    // ceil(log2(n+1)) levels, at the very least, and a path at the very most
+    unsigned int fullLevels = 0;
+    while (fullLevels < 64 && ((size_t)1 << fullLevels) - 1 < nodeCount)
+        fullLevels++;
+    
+    treeStats.minHeight = fullLevels;
+    treeStats.maxHeight = (unsigned int)nodeCount;
+    treeStats.minLeafDepth = 0;
+    treeStats.maxLeafDepth = (nodeCount > 0 ? (unsigned int)nodeCount - 1 : 0);
     
-    // Check for red violations
+    // The policy knows better
+    balancer.fillStats(*this, treeStats);
+    
+    return treeStats;
+}
+
+template <typename btNodeType, typename BalancePolicy>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::select(size_t k) const
+{
+#ifdef SUBTREE_SIZES
+    const TreeNode *current = treeRoot;
     
-    // case 1: Black node with two red children
-    //          Turn it into a red node, with two black children
-    //          Basically splitting up a four node
-    if (wNode.isBlack() && TreeNode::isRed(wNode[LEFT]) && TreeNode::isRed(wNode[RIGHT]))
+    // At each node, the left subtree holds the leftSize smallest keys.
+    // Either we want one of those, this node, or we skip past them all and go right
+    while (current != nullptr)
     {
-        // The root can't be red!
-        if (!isRoot(node))
-            node->setToRed();
+        size_t leftSize = TreeNode::sizeOf(current->leftNode);
         
-        if (wNode[LEFT] != nullptr) wNode[LEFT]->setToBlack();
-        if (wNode[RIGHT] != nullptr) wNode[RIGHT]->setToBlack();
-        treeChanged =  true;
+        if (k < leftSize)
+        {
+            current = current->leftNode;
+        }
+        else if (k == leftSize)
+        {
+            break;
+        }
+        else
+        {
+            k -= leftSize + 1;
+            current = current->rightNode;
+        }
     }
-    else
+    
+    return const_cast<btNodeType *>(nodeCast<btNodeType>(current));
+#else
+    const_iterator it = begin();
+    
+    while (it != end() && k-- > 0)
+        ++it;
+    
+    return const_cast<btNodeType *>(it.getNode());
+#endif
+}
+
+// Count the nodes less than key (or less than or equal, if inclusive)
+template <typename btNodeType, typename BalancePolicy>
+template <typename KeyT>
+size_t BinaryTree<btNodeType, BalancePolicy>::countBelow(const KeyT &key, bool inclusive) const
+{
+#ifdef SUBTREE_SIZES
+    treeTimeOp(treeOpLookup);
+    
+    const TreeNode *current = treeRoot;
+    size_t count = 0;
+    typename probeFor<btNodeType, KeyT>::type probe(key);
+    
+    // Every time we go right, this node and its whole left subtree are below key
+    while (current != nullptr)
     {
-        // Check for configurations that need rotation
-        // First, two reds in a row on the branch where we just added a node
-        // \todo Code it the hard way, make better syntax later
-        if (wNode[whichSide] != nullptr && wNode[whichSide]->isRed())
+        int compResult = nodeCast<btNodeType>(current)->compareKey(probe);
+        treeCount(counters.totalComparisons++);
+        
+        if (compResult < 0 || (compResult == 0 && !inclusive))
         {
-            NodeWrap<btNodeType> wSide(wNode[whichSide]);
-
-            if (wSide[whichSide] != nullptr && wSide[whichSide]->isRed())
-            {
-                newNode = doRotation(node, !whichSide);
-                treeChanged = true;
-            }
-            else if (wSide[!whichSide] != nullptr && wSide[!whichSide]->isRed())
-            {
-                newNode = doDoubleRotation(node, !whichSide);
-                treeChanged = true;
-            }
+            current = current->leftNode;
+        }
+        else
+        {
+            count += TreeNode::sizeOf(current->leftNode) + 1;
+            current = current->rightNode;
         }
     }
-
     
-    // Now, go up the tree and rebalance some more, unless we're at the top
-    if (newNode->parentNode == nullptr)
-        return;
+    return count;
+#else
+    const_iterator bound = (inclusive ? upper_bound(key) : lower_bound(key));
+    
+    return std::distance(begin(), bound);
+#endif
+}
+
+// In-order tree traversal == sorted tree values
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::dumpSortedTree(const TreeNode *node)
+{
+    // do the left branch, this node, and the right branch
+    // should get sorted list
+    if (node == nullptr) return;
     
-    // We want to go up the tree and re-balance as we go.  We want to rebalance the
-    // side (right or left) of the subtree from whence we came
-    TreeNode::NodeDirection fromWhence = newNode->getParentDir();
+    dumpSortedTree(node->leftNode);
     
-    assert(fromWhence != NONE);
+    dumpNodeInfo(nodeCast<btNodeType>(node));
     
-    reBalance(dynamic_cast<btNodeType *>(newNode->parentNode), fromWhence);
+    dumpSortedTree(node->rightNode);
 }
 
-// We know that the node[rotateDir] is red and node[rotateDir][rotateDir] is red
-template <typename btNodeType>
-btNodeType *BinaryTree<btNodeType>::doRotation(btNodeType *node,
-                                               TreeNode::NodeDirection rotateDir)
+// Pre-order tree traversal gives us the root first, a little
+// easier to look at for debugging
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::dumpPreOrderTree(const TreeNode *node)
 {
+    // do the left branch, this node, and the right branch
+    // should get sorted list
+    if (node == nullptr) return;
+    
+    dumpNodeInfo(nodeCast<btNodeType>(node));
+    
+    dumpPreOrderTree(node->leftNode);
+    
+    dumpPreOrderTree(node->rightNode);
+}
 
+// Rotate around node, to the rotateDir side: node's child on the other side comes
+// up into node's place, and node goes down on the rotateDir side of it.  Only the
+// links and subtree sizes change; recoloring or reweighing is up to the policy.
+template <typename btNodeType, typename BalancePolicy>
+btNodeType *BinaryTree<btNodeType, BalancePolicy>::rotate(btNodeType *node,
+                                                          TreeNode::NodeDirection rotateDir)
+{
+    
     NodeWrap<btNodeType> wNode(node);
     btNodeType *save = wNode[!rotateDir];
     NodeWrap<btNodeType> wSave(save);
     
     debugPrintf("===================\n");
-    debugPrintf2("\nBefore rotation around '%s' to the %s:\n", node->getCValue(), directionString(rotateDir));
+    debugPrintf2("\nBefore rotation around '%s' to the %s:\n", describeNode(node).c_str(), directionString(rotateDir));
 #ifdef DEBUG_OUTPUT
     dumpPreOrderTree(node);
 #endif
     debugPrintf("===================\n");
     
-    // Core of the rotation
-    save->setToBlack();
-    node->setToRed();
+    treeCount(counters.rotations++);
+    beginMove();
     
     // Get the old node's parent's pointer so we can reset it
     btNodeType **parentPointer = nullptr;
@@ -409,20 +1408,23 @@ btNodeType *BinaryTree<btNodeType>::doRotation(btNodeType *node,
     // Read as: Take the node's link opposite to the direction of rotation, and change it
     // to THAT node's link in the direction of the rotation
     // Put another way node->{opposite to rotation}node = node->{opposite to rotation}node->{rotation direction link}node
-    *(wNode(!rotateDir)) = wSave[rotateDir];
+    //
+    // The links change in this order so a Reader never sees a loop: node lets go of
+    // save before save takes hold of node.
+    publishLink(*(wNode(!rotateDir)), wSave[rotateDir]);
     
     // Read as: node->{opposite to rotation}node->{rotation direction link} = original node
-    *(wSave(rotateDir)) = node;
+    publishLink(*(wSave(rotateDir)), node);
     
     // Fix the parent node relationships
     
     // Make sure the new parent nodes point back at their new childer
     if (node->parentNode != nullptr)  // check if we're at the root node
     {
-        NodeWrap<btNodeType> wParentNode(dynamic_cast<btNodeType *>(node->parentNode));
+        NodeWrap<btNodeType> wParentNode(nodeCast<btNodeType>(node->parentNode));
         parentPointer = wParentNode(node->getParentDir());
         assert(parentPointer != nullptr);
-        *parentPointer = save;  
+        publishLink(*parentPointer, save);
     }
     
     if (wNode[!rotateDir] != nullptr)
@@ -435,15 +1437,24 @@ btNodeType *BinaryTree<btNodeType>::doRotation(btNodeType *node,
     
     // The original node's parent is now the "top" node
     node->parentNode = save;
-
+    
+#ifdef SUBTREE_SIZES
+    // Only the two nodes that swapped places have different descendants now,
+    // bottom one first
+    node->recomputeSize();
+    save->recomputeSize();
+#endif
+    
     // Do we have a new root?
     if (save->parentNode == nullptr)
     {
-        makeRoot(save);
+        publishLink(treeRoot, save);
     }
     
+    endMove();
+    
     debugPrintf("===================\n");
-    debugPrintf2("\nAfter rotation around '%s' to the %s:\n", node->getCValue(), directionString(rotateDir));
+    debugPrintf2("\nAfter rotation around '%s' to the %s:\n", describeNode(node).c_str(), directionString(rotateDir));
 #ifdef DEBUG_OUTPUT
     dumpPreOrderTree(save);
 #endif
@@ -454,44 +1465,168 @@ btNodeType *BinaryTree<btNodeType>::doRotation(btNodeType *node,
     
 }
 
-template <typename btNodeType>
-btNodeType *BinaryTree<btNodeType>::doDoubleRotation(btNodeType *node,
-                                               TreeNode::NodeDirection rotateDir)
+template <typename btNodeType, typename BalancePolicy>
+template <typename KeyT>
+size_t BinaryTree<btNodeType, BalancePolicy>::erase(const KeyT &key)
+{
+    treeTimeOp(treeOpErase);
+    
+    btNodeType *node = find(key);
+    
+    if (node == nullptr)
+        return 0;
+    
+    erase(node);
+    return 1;
+}
+
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::erase(btNodeType *node)
+{
+    assert(node != nullptr);
+    debugPrintf2("Erasing node %p, with value '%s'\n", node, describeNode(node).c_str());
+    treeTimeOp(treeOpErase);
+    
+    unlinkNode(node);
+    
+    if (epochs != nullptr)
+        retireNode(node);
+    else
+        releaseNode(node);
+    nodeCount--;
+    
+    validateAfterChange(lastTouchedNode);
+}
+
+// Take a node out of the tree, and have the balance policy put the balance right.
+// The node itself is left alone (other than clearing its links), so the
+// caller decides what happens to it.
+//
+// If the node has two children, its in-order successor (which has no left child)
+// is moved into its place, trading balancing state with it, so the "real" removal
+// always happens at a node with at most one child, and the node we hand the policy
+// carries the state of the spot that really went away.
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::unlinkNode(btNodeType *node)
 {
-    // First, do a single rotation so that red grandchild is on the same side and the red child
+    // Some policies would rather move the node down out of the way first
+    balancer.beforeErase(*this, node);
+    beginMove();
+    
     NodeWrap<btNodeType> wNode(node);
+    btNodeType *replacement;        // node that moves into the removed node's spot
+    btNodeType *replacementParent;  // its parent afterwards (needed when it's null)
+    
+    if (wNode[LEFT] == nullptr)
+    {
+        replacement = wNode[RIGHT];
+        replacementParent = wNode[PARENT];
+        transplant(node, wNode[RIGHT]);
+    }
+    else if (wNode[RIGHT] == nullptr)
+    {
+        replacement = wNode[LEFT];
+        replacementParent = wNode[PARENT];
+        transplant(node, wNode[LEFT]);
+    }
+    else
+    {
+        // Successor is the leftmost node in the right subtree
+        btNodeType *successor = wNode[RIGHT];
+        while (successor->leftNode != nullptr)
+            successor = nodeCast<btNodeType>(successor->leftNode);
+        
+        NodeWrap<btNodeType> wSuccessor(successor);
+        replacement = wSuccessor[RIGHT];
+        
+        if (successor->parentNode == node)
+        {
+            replacementParent = successor;
+        }
+        else
+        {
+            replacementParent = wSuccessor[PARENT];
+            transplant(successor, wSuccessor[RIGHT]);
+            publishLink(successor->rightNode, node->rightNode);
+            successor->rightNode->parentNode = successor;
+        }
+        
+        transplant(node, successor);
+        publishLink(successor->leftNode, node->leftNode);
+        successor->leftNode->parentNode = successor;
+        
+        node->swapBalance(successor);
+        
+#ifdef SUBTREE_SIZES
+        // The successor takes over the node's subtree, it gets knocked back down
+        // by one along with everything else on the way up below
+        successor->setSubtreeSize(node->getSubtreeSize());
+#endif
+    }
+    
+#ifdef SUBTREE_SIZES
+    // Everything from the spot where a node actually came out, up to the root,
+    // has one less node below it
+    for (TreeNode *up = replacementParent ; up != nullptr ; up = up->parentNode)
+        up->setSubtreeSize(up->getSubtreeSize() - 1);
+    
+    node->setSubtreeSize(1);
+#endif
+    
+    publishLink<TreeNode>(node->leftNode, nullptr);
+    publishLink<TreeNode>(node->rightNode, nullptr);
+    node->parentNode = nullptr;
+    lastTouchedNode = (replacementParent != nullptr ? replacementParent : treeRoot);
+    endMove();
+    
+    balancer.afterErase(*this, node, replacement, replacementParent);
+}
+
+// Put newNode where oldNode hangs in the tree (newNode may be null).
+// oldNode's own child links are left untouched.
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::transplant(btNodeType *oldNode, btNodeType *newNode)
+{
+    if (oldNode->parentNode == nullptr)
+    {
+        publishLink(treeRoot, newNode);
+    }
+    else
+    {
+        NodeWrap<btNodeType> wParent(nodeCast<btNodeType>(oldNode->parentNode));
+        publishLink(*(wParent(oldNode->getParentDir())), newNode);
+    }
     
-    debugPrintf2("*** Double rotation around %s, to the %s\n", node->getCValue(), directionString(rotateDir));
-    *(wNode(!rotateDir)) = doRotation(wNode[!rotateDir], !rotateDir); 
-    return doRotation(node, rotateDir);
+    if (newNode != nullptr)
+        newNode->parentNode = oldNode->parentNode;
 }
 
 #ifdef DEBUG_OUTPUT
 template <typename btNodeType>
 void littleDumpNode(btNodeType *node)
 {
-    debugPrintf3("Node: '%s' (%p) %s\n", node->getCValue(), (void *)node, node->isRed() ? "red" : "black");
-    btNodeType *right = dynamic_cast<btNodeType *>(node->rightNode);
-    btNodeType *left = dynamic_cast<btNodeType *>(node->leftNode);
-    btNodeType *parent = dynamic_cast<btNodeType *>(node->parentNode);
+    debugPrintf3("Node: '%s' (%p) %s\n", describeNode(node).c_str(), (void *)node, node->isRed() ? "red" : "black");
+    btNodeType *right = nodeCast<btNodeType>(node->rightNode);
+    btNodeType *left = nodeCast<btNodeType>(node->leftNode);
+    btNodeType *parent = nodeCast<btNodeType>(node->parentNode);
     
     debugPrintf("\tLeft: ");
     if (left == nullptr)
         debugPrintf("NULL\n");
     else
-        debugPrintf3("'%s' (%p) %s\n", left->getCValue(), (void *)left, left->isRed() ? "red" : "black");
+        debugPrintf3("'%s' (%p) %s\n", describeNode(left).c_str(), (void *)left, left->isRed() ? "red" : "black");
     
     debugPrintf("\tRight: ");
     if (right == nullptr)
         debugPrintf("NULL\n");
     else
-        debugPrintf3("'%s' (%p) %s\n", right->getCValue(), (void *)left, right->isRed() ? "red" : "black");
+        debugPrintf3("'%s' (%p) %s\n", describeNode(right).c_str(), (void *)right, right->isRed() ? "red" : "black");
     
     debugPrintf("\tParent: ");
     if (parent == nullptr)
         debugPrintf("NULL\n");
     else
-        debugPrintf3("'%s' (%p) %s\n", parent->getCValue(), (void *)parent, parent->isRed() ? "red" : "black");
+        debugPrintf3("'%s' (%p) %s\n", describeNode(parent).c_str(), (void *)parent, parent->isRed() ? "red" : "black");
     
 }
 #else
@@ -503,40 +1638,159 @@ void littleDumpNode(btNodeType *node)
 #endif
 
 #define ERROR_ASSERTS
-#ifdef ERROR_ASSERTS
-#define VERIFY_ERROR(x)  { \
+#ifdef VISUALIZE_ERRORS
+#define VISUALIZE_ERROR()  { \
                             Visualize *vis = new Visualize(getRoot()); \
                             vis->makeVisualization(); \
+                         }
+#else
+#define VISUALIZE_ERROR()
+#endif
+#ifdef ERROR_ASSERTS
+#define VERIFY_ERROR(x)  { \
+                            VISUALIZE_ERROR(); \
                             assert(x); \
+                            return(x); \
                          }
 #else
 #define VERIFY_ERROR(x)  return(x)
 #endif
-// Verify that a tree is a valid red-black binary tree
-template <typename btNodeType>
-unsigned int BinaryTree<btNodeType>::verifyTree(const btNodeType *theRoot)
+
+// Run whatever checking the validation level calls for after a change to the tree.
+// touched is the lowest node the change affected (for validatePath).
+template <typename btNodeType, typename BalancePolicy>
+void BinaryTree<btNodeType, BalancePolicy>::validateAfterChange(btNodeType *touched)
 {
+    bool fullCheck;
+    
+    switch (validationLevel)
+    {
+        case validateOff:
+            return;
+            
+        case validatePath:
+            fullCheck = false;
+            break;
+            
+        case validateSampled:
+            if (++changesSinceCheck < sampleInterval)
+                return;
+            changesSinceCheck = 0;
+            fullCheck = true;
+            break;
+            
+        case validateFull:
+        default:
+            fullCheck = true;
+            break;
+    }
     
-    int leftBlackCount = 0,
-                 rightBlackCount = 0;  // black node depths
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
     
-    if (theRoot == nullptr)
-        return 1;
+    bool valid = (fullCheck ? verifyTree(getRoot()) != 0 && verifyStats() : verifyPath(touched));
+    
+    validationNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    validationChecks++;
     
-    const btNodeType *leftNode = dynamic_cast<const btNodeType *>(theRoot->leftNode);
-    const btNodeType *rightNode = dynamic_cast<const btNodeType *>(theRoot->rightNode);
+    assert(valid);
+    (void)valid;
+}
+
+// Check the incrementally kept counts against the real tree
+template <typename btNodeType, typename BalancePolicy>
+bool BinaryTree<btNodeType, BalancePolicy>::verifyStats()
+{
+    size_t realCount = 0;
+    
+    for (const_iterator it = cbegin() ; it != cend() ; ++it)
+        realCount++;
     
-    // Check for consecutive red links
-    if (theRoot->isRed() &&
-        (((leftNode != nullptr) && leftNode->isRed()) || 
-        (rightNode != nullptr && rightNode->isRed())))
+    if (realCount != nodeCount)
     {
-        cerr << "Red violation, node " << (void *)theRoot << endl;
-        VERIFY_ERROR(0);
+        cerr << "Tree stats out of date: " << nodeCount << " nodes, should be " << realCount << endl;
+        VERIFY_ERROR(false);
+    }
+    
+    if (!balancer.verifyState(*this))
+        VERIFY_ERROR(false);
+    
+    return true;
+}
+
+// Check everything that can be checked without looking at whole subtrees, for each
+// node from node up to the root, and for their children.  That covers the new node
+// and every node a rotation or recoloring in the fixups could have moved: they're
+// all on that path or hanging right off it.  What it can't see is black height,
+// which needs whole subtrees; use a full check for that.
+template <typename btNodeType, typename BalancePolicy>
+bool BinaryTree<btNodeType, BalancePolicy>::verifyPath(const btNodeType *node)
+{
+    if (treeRoot == nullptr)
+        return true;
+    
+    if (treeRoot->parentNode != nullptr || !balancer.verifyState(*this))
+    {
+        cerr << "Bad root node " << (void *)treeRoot << endl;
+        VERIFY_ERROR(false);
+    }
+    
+    for ( ; node != nullptr ; node = nodeCast<btNodeType>(node->parentNode))
+    {
+        if (!verifyLocal(node) ||
+            (node->leftNode != nullptr && !verifyLocal(nodeCast<btNodeType>(node->leftNode))) ||
+            (node->rightNode != nullptr && !verifyLocal(nodeCast<btNodeType>(node->rightNode))))
+            return false;
+    }
+    
+    return true;
+}
+
+// Checks on a single node against its immediate children
+template <typename btNodeType, typename BalancePolicy>
+bool BinaryTree<btNodeType, BalancePolicy>::verifyLocal(const btNodeType *theNode)
+{
+    const btNodeType *leftNode = nodeCast<btNodeType>(theNode->leftNode);
+    const btNodeType *rightNode = nodeCast<btNodeType>(theNode->rightNode);
+    
+    if (!balancer.verifyLocal(theNode))
+        VERIFY_ERROR(false);
+    
+    if ((leftNode != nullptr && (leftNode->parentNode != theNode || leftNode->compare(theNode) <= 0)) ||
+        (rightNode != nullptr && (rightNode->parentNode != theNode || rightNode->compare(theNode) >= 0)))
+    {
+        cerr << "Bad binary tree at node " << (void *)theNode << endl;
+        VERIFY_ERROR(false);
+    }
+    
+#ifdef SUBTREE_SIZES
+    if (theNode->getSubtreeSize() != 1 + TreeNode::sizeOf(leftNode) + TreeNode::sizeOf(rightNode))
+    {
+        cerr << "Bad subtree size at node " << (void *)theNode << endl;
+        VERIFY_ERROR(false);
     }
+#endif
+    
+    return true;
+}
+
+// Verify that a tree is a valid binary search tree, links and sizes in order, that
+// meets its balance policy's invariants.  Returns the policy's measure of the
+// subtree (black height for red-black, height for AVL), which is 1 for an empty
+// subtree, or 0 if anything's wrong.
+template <typename btNodeType, typename BalancePolicy>
+unsigned int BinaryTree<btNodeType, BalancePolicy>::verifyTree(const btNodeType *theRoot)
+{
+    if (theRoot == nullptr)
+        return 1;
+    
+    const btNodeType *leftNode = nodeCast<btNodeType>(theRoot->leftNode);
+    const btNodeType *rightNode = nodeCast<btNodeType>(theRoot->rightNode);
     
-    leftBlackCount = verifyTree(leftNode);
-    rightBlackCount = verifyTree(rightNode);
+    unsigned int leftMeasure = verifyTree(leftNode);
+    unsigned int rightMeasure = verifyTree(rightNode);
+    
+    if (leftMeasure == 0 || rightMeasure == 0)
+        return 0;  // already reported
     
     // Check for invalid binary search tree
     if ((leftNode != nullptr && leftNode->compare(theRoot) <= 0) ||
@@ -553,26 +1807,26 @@ unsigned int BinaryTree<btNodeType>::verifyTree(const btNodeType *theRoot)
             VERIFY_ERROR(0);
     }
     
-    // Check for black height
-    if (leftBlackCount != 0 && rightBlackCount != 0 && leftBlackCount != rightBlackCount )
+#ifdef SUBTREE_SIZES
+    // Check subtree sizes
+    if (theRoot->getSubtreeSize() != 1 + TreeNode::sizeOf(leftNode) + TreeNode::sizeOf(rightNode))
     {
-        cerr << "Black violation at node " << (void *)theRoot << endl;
-
+        cerr << "Bad subtree size at node " << (void *)theRoot << endl;
         VERIFY_ERROR(0);
-        
     }
+#endif
     
-    // return current black height at this node
-    // ignore red nodes ('cause they're not black!)
-    if (rightBlackCount != 0 && leftBlackCount != 0)
-    {
-        return theRoot->isRed() ? leftBlackCount : leftBlackCount+1;
-    }
-    else
-    {
+    // Then the policy's own rules
+    unsigned int measure = balancer.verifyNode(theRoot, leftMeasure, rightMeasure);
+    
+    if (measure == 0)
         VERIFY_ERROR(0);
-    }
+    
+    return measure;
 }
 
+// The default policy, which needs the whole of BinaryTree first
+#include "RedBlackBalance.h"
+
 
 #endif /* defined(__Tree_exercises__BinaryTree__) */
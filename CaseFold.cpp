@@ -0,0 +1,107 @@
+//
+//  CaseFold.cpp
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#include "CaseFold.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FOLD_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+typedef size_t (*MismatchKernel)(const char *lhs, const char *rhs, size_t length);
+
+/// Plain byte at a time version, for when there's no vector unit we know about,
+/// and for the tail end of the vector versions
+static size_t foldMismatchScalar(const char *lhs, const char *rhs, size_t length)
+{
+    size_t i = 0;
+    
+    while (i < length && foldByte(lhs[i]) == foldByte(rhs[i]))
+        i++;
+    
+    return i;
+}
+
+#ifdef FOLD_SIMD_X86
+/// Fold 16 bytes at once.  Bytes 0x80 and up compare as negative, so they
+/// fall outside 'A'-'Z' like they should.
+static inline __m128i fold16(__m128i bytes)
+{
+    __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('A' - 1)),
+                                    _mm_cmplt_epi8(bytes, _mm_set1_epi8('Z' + 1)));
+    
+    return _mm_add_epi8(bytes, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+}
+
+/// SSE2 is part of x86-64, so this one is always available there
+static size_t foldMismatchSSE2(const char *lhs, const char *rhs, size_t length)
+{
+    size_t i = 0;
+    
+    for ( ; i + 16 <= length ; i += 16)
+    {
+        __m128i l = fold16(_mm_loadu_si128((const __m128i *)(lhs + i)));
+        __m128i r = fold16(_mm_loadu_si128((const __m128i *)(rhs + i)));
+        unsigned differ = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) ^ 0xFFFFu;
+        
+        if (differ != 0)
+            return i + __builtin_ctz(differ);
+    }
+    
+    return i + foldMismatchScalar(lhs + i, rhs + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fold32(__m256i bytes)
+{
+    __m256i isUpper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('A' - 1)),
+                                       _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), bytes));
+    
+    return _mm256_add_epi8(bytes, _mm256_and_si256(isUpper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+static size_t foldMismatchAVX2(const char *lhs, const char *rhs, size_t length)
+{
+    size_t i = 0;
+    
+    for ( ; i + 32 <= length ; i += 32)
+    {
+        __m256i l = fold32(_mm256_loadu_si256((const __m256i *)(lhs + i)));
+        __m256i r = fold32(_mm256_loadu_si256((const __m256i *)(rhs + i)));
+        unsigned differ = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(l, r));
+        
+        if (differ != 0)
+            return i + __builtin_ctz(differ);
+    }
+    
+    // Finish up 16 at a time, then a byte at a time
+    return i + foldMismatchSSE2(lhs + i, rhs + i, length - i);
+}
+#endif
+
+/// Pick the widest kernel this CPU can run
+static MismatchKernel chooseMismatchKernel()
+{
+#ifdef FOLD_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return foldMismatchAVX2;
+    
+    return foldMismatchSSE2;
+#else
+    return foldMismatchScalar;
+#endif
+}
+
+size_t foldMismatch(const char *lhs, const char *rhs, size_t length)
+{
+    static const MismatchKernel kernel = chooseMismatchKernel();
+    
+    return kernel(lhs, rhs, length);
+}
@@ -0,0 +1,86 @@
+//
+//  CaseFold.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__CaseFold__
+#define __Tree_exercises__CaseFold__
+
+#include <cstddef>
+#include <cstdint>
+
+/// ASCII case folding, 'A'-'Z' become 'a'-'z' and everything else is left alone
+inline unsigned char foldByte(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 32) : (unsigned char)c;
+}
+
+/// Does this string have any upper case letters in it?
+inline bool needsFolding(const char *str, size_t length)
+{
+    for (size_t i = 0 ; i < length ; i++)
+    {
+        if (str[i] >= 'A' && str[i] <= 'Z')
+            return true;
+    }
+    
+    return false;
+}
+
+/// Copy length bytes from src to dst, folding them on the way
+inline void foldCopy(char *dst, const char *src, size_t length)
+{
+    for (size_t i = 0 ; i < length ; i++)
+        dst[i] = (char)foldByte(src[i]);
+}
+
+/// The first 8 folded bytes of a string packed big-endian into an integer, zero
+/// padded if the string is shorter.  Comparing two of these as integers orders the
+/// same way foldCompare does on those bytes, which makes for a cheap first test.
+inline uint64_t foldedPrefix(const char *str, size_t length)
+{
+    uint64_t prefix = 0;
+    
+    for (size_t i = 0 ; i < sizeof(uint64_t) ; i++)
+        prefix = (prefix << 8) | (i < length ? foldByte(str[i]) : 0);
+    
+    return prefix;
+}
+
+/// Index of the first byte where lhs and rhs differ once folded, or length if
+/// they match all the way.  Vectorized (AVX2 or SSE2, picked at runtime), for
+/// the long strings the inline compare below hands off.
+size_t foldMismatch(const char *lhs, const char *rhs, size_t length);
+
+/// Case insensitive three way compare of two byte ranges, without copying
+/// either one.  Orders the same as folding both and then string::compare():
+/// byte by byte as unsigned chars, and a prefix sorts before the longer string.
+inline int foldCompare(const char *lhs, size_t lhsLength, const char *rhs, size_t rhsLength)
+{
+    size_t commonLength = (lhsLength < rhsLength ? lhsLength : rhsLength);
+    size_t i = 0;
+    
+    // Most words are short, and for those a plain loop beats setting up vectors
+    if (commonLength >= 16)
+    {
+        i = foldMismatch(lhs, rhs, commonLength);
+    }
+    else
+    {
+        while (i < commonLength && foldByte(lhs[i]) == foldByte(rhs[i]))
+            i++;
+    }
+    
+    if (i < commonLength)
+        return (foldByte(lhs[i]) < foldByte(rhs[i]) ? -1 : 1);
+    
+    if (lhsLength == rhsLength)
+        return 0;
+    
+    return (lhsLength < rhsLength ? -1 : 1);
+}
+
+#endif /* defined(__Tree_exercises__CaseFold__) */
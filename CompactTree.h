@@ -0,0 +1,750 @@
+//
+//  CompactTree.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__CompactTree__
+#define __Tree_exercises__CompactTree__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "TreeMap.h"
+
+/// Red-black tree map laid out for footprint.  Where a BinaryTree node carries
+/// three 8 byte links, a color byte and a stored depth (plus padding), every node
+/// here lives in one array and links to others by 32-bit index, with the color
+/// folded into the top bit of the parent index.  Nothing else is stored: no
+/// vtable, no depth, no subtree size.  With a 64-bit key and a 32-bit value that's
+/// 24 bytes a node, 8 byte key and value 32, so two or more nodes to a cache line,
+/// against a 40 byte TreeNode before it holds any key at all.  A tree that takes
+/// a third or less of the memory is the one that stays in L3.
+///
+/// Index 0 is a black sentinel standing in for null, so the fixups never have to
+/// check for a missing child (it's the classic sentinel formulation).  Erased
+/// nodes go on a free list and are reused by the next insert; the array itself
+/// only grows, until clear().
+///
+/// Keys order through KeyOrder (see TreeMap.h), so integer and fixed width keys
+/// get the same inlined comparisons TreeMap's do.  KeyT and ValueT have to be
+/// default constructible and assignable (the sentinel and reused slots need that);
+/// this is meant for small keys and values, IDs, timestamps, offsets.  At most
+/// 2^31 - 1 nodes.
+template <typename KeyT, typename ValueT, typename CompareT = std::less<KeyT> >
+class CompactTreeMap
+{
+public:
+    typedef uint32_t NodeIndex;
+    typedef KeyT key_type;
+    typedef ValueT mapped_type;
+    typedef size_t size_type;
+    
+    static const NodeIndex nil = 0;
+    static const NodeIndex maxNodes = 0x7fffffff;
+    
+    class Node
+    {
+    public:
+        Node() : parentAndColor(0)
+        {
+            child[0] = child[1] = nil;
+        }
+        
+        Node(const KeyT &nodeKey, const ValueT &nodeValue) : key(nodeKey), value(nodeValue), parentAndColor(0)
+        {
+            child[0] = child[1] = nil;
+        }
+        
+        const KeyT &getKey() const
+        {
+            return key;
+        }
+        
+        ValueT &getMapped()
+        {
+            return value;
+        }
+        
+        const ValueT &getMapped() const
+        {
+            return value;
+        }
+    
+    private:
+        friend class CompactTreeMap;
+        
+        static const NodeIndex redBit = 0x80000000;
+        
+        KeyT key;
+        ValueT value;
+        NodeIndex child[2];         // left, right
+        NodeIndex parentAndColor;   // parent index, red if the top bit is set
+    };
+    
+    /// Bidirectional in-order iterator, a tree and an index.  Inserts don't
+    /// invalidate it (even when the array moves); erasing its node does.
+    template <typename treeType, typename nodeType>
+    class compactIterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef nodeType value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef nodeType *pointer;
+        typedef nodeType &reference;
+        
+        compactIterator() : theTree(nullptr), index(nil)
+        {
+            
+        }
+        
+        compactIterator(treeType *tree, NodeIndex nodeIndex) : theTree(tree), index(nodeIndex)
+        {
+            
+        }
+        
+        operator compactIterator<const treeType, const nodeType>() const
+        {
+            return compactIterator<const treeType, const nodeType>(theTree, index);
+        }
+        
+        reference operator*() const
+        {
+            return theTree->nodes[index];
+        }
+        
+        pointer operator->() const
+        {
+            return &theTree->nodes[index];
+        }
+        
+        compactIterator &operator++()
+        {
+            assert(index != nil);  // can't go past end()
+            index = theTree->nextIndex(index);
+            return *this;
+        }
+        
+        compactIterator operator++(int)
+        {
+            compactIterator before(*this);
+            ++(*this);
+            return before;
+        }
+        
+        compactIterator &operator--()
+        {
+            index = (index == nil ? theTree->extremeIndex(theTree->root, 1) : theTree->prevIndex(index));
+            return *this;
+        }
+        
+        compactIterator operator--(int)
+        {
+            compactIterator before(*this);
+            --(*this);
+            return before;
+        }
+        
+        bool operator==(const compactIterator &rhs) const
+        {
+            return index == rhs.index;
+        }
+        
+        bool operator!=(const compactIterator &rhs) const
+        {
+            return index != rhs.index;
+        }
+        
+        NodeIndex getIndex() const
+        {
+            return index;
+        }
+    
+    private:
+        treeType *theTree;
+        NodeIndex index;
+    };
+    
+    typedef compactIterator<CompactTreeMap, Node> iterator;
+    typedef compactIterator<const CompactTreeMap, const Node> const_iterator;
+    
+    CompactTreeMap() : root(nil), freeList(nil), nodeCount(0), blackHeight(0)
+    {
+        nodes.resize(1);   // the sentinel
+    }
+    
+    size_t size() const
+    {
+        return nodeCount;
+    }
+    
+    bool empty() const
+    {
+        return nodeCount == 0;
+    }
+    
+    /// Make room for n nodes up front, so building the tree doesn't copy the array
+    void reserve(size_t n)
+    {
+        nodes.reserve(n + 1);
+    }
+    
+    void clear()
+    {
+        nodes.clear();
+        nodes.resize(1);
+        root = freeList = nil;
+        nodeCount = 0;
+        blackHeight = 0;
+    }
+    
+    /// Bytes the node array has claimed, erased slots and spare capacity included
+    size_t getBytesReserved() const
+    {
+        return nodes.capacity() * sizeof(Node);
+    }
+    
+    /// Black nodes on every path from the root down to a null, see TreeStats
+    unsigned int getBlackHeight() const
+    {
+        return blackHeight;
+    }
+    
+    iterator begin()
+    {
+        return iterator(this, extremeIndex(root, 0));
+    }
+    
+    iterator end()
+    {
+        return iterator(this, nil);
+    }
+    
+    const_iterator begin() const
+    {
+        return const_iterator(this, extremeIndex(root, 0));
+    }
+    
+    const_iterator end() const
+    {
+        return const_iterator(this, nil);
+    }
+    
+    /// Add key with value, unless key is already there.  Returns where key is, and
+    /// whether it's new.
+    std::pair<iterator, bool> try_emplace(const KeyT &key, const ValueT &value = ValueT());
+    
+    /// Add key with value, or if it's already there, give it value instead
+    std::pair<iterator, bool> insert_or_assign(const KeyT &key, const ValueT &value)
+    {
+        std::pair<iterator, bool> result = try_emplace(key, value);
+        
+        if (!result.second)
+            result.first->value = value;
+        return result;
+    }
+    
+    ValueT &operator[](const KeyT &key)
+    {
+        return try_emplace(key).first->value;
+    }
+    
+    iterator find(const KeyT &key)
+    {
+        return iterator(this, findIndex(key));
+    }
+    
+    const_iterator find(const KeyT &key) const
+    {
+        return const_iterator(this, findIndex(key));
+    }
+    
+    bool contains(const KeyT &key) const
+    {
+        return findIndex(key) != nil;
+    }
+    
+    /// First node whose key isn't less than key (lower) or is greater (upper)
+    iterator lower_bound(const KeyT &key)
+    {
+        return iterator(this, boundIndex(key, false));
+    }
+    
+    iterator upper_bound(const KeyT &key)
+    {
+        return iterator(this, boundIndex(key, true));
+    }
+    
+    const_iterator lower_bound(const KeyT &key) const
+    {
+        return const_iterator(this, boundIndex(key, false));
+    }
+    
+    const_iterator upper_bound(const KeyT &key) const
+    {
+        return const_iterator(this, boundIndex(key, true));
+    }
+    
+    /// Remove key if it's there.  Returns the number of nodes removed (0 or 1).
+    size_t erase(const KeyT &key)
+    {
+        NodeIndex doomed = findIndex(key);
+        
+        if (doomed == nil)
+            return 0;
+        
+        eraseIndex(doomed);
+        return 1;
+    }
+    
+    /// Remove the node at pos, returning the one after it
+    iterator erase(iterator pos)
+    {
+        NodeIndex next = nextIndex(pos.getIndex());
+        
+        eraseIndex(pos.getIndex());
+        return iterator(this, next);
+    }
+    
+    /// Check the whole tree: order, parent links, no red node with a red child,
+    /// the same number of black nodes on every path, and the node count.
+    /// O(n), for debugging and tests.
+    bool verifyTree() const;
+
+private:
+    // Accessors for the packed links.  The sentinel's parent does get written
+    // (erase relies on that), but it's never made red.
+    NodeIndex &childOf(NodeIndex i, int dir)
+    {
+        return nodes[i].child[dir];
+    }
+    
+    NodeIndex childOf(NodeIndex i, int dir) const
+    {
+        return nodes[i].child[dir];
+    }
+    
+    NodeIndex parentOf(NodeIndex i) const
+    {
+        return nodes[i].parentAndColor & ~Node::redBit;
+    }
+    
+    void setParent(NodeIndex i, NodeIndex parent)
+    {
+        nodes[i].parentAndColor = (nodes[i].parentAndColor & Node::redBit) | parent;
+    }
+    
+    bool isRed(NodeIndex i) const
+    {
+        return (nodes[i].parentAndColor & Node::redBit) != 0;
+    }
+    
+    void setRed(NodeIndex i, bool red)
+    {
+        nodes[i].parentAndColor = (nodes[i].parentAndColor & ~Node::redBit) | (red ? Node::redBit : 0);
+    }
+    
+    /// Which side of its parent i is on
+    int sideOf(NodeIndex i, NodeIndex parent) const
+    {
+        return (childOf(parent, 0) == i ? 0 : 1);
+    }
+    
+    NodeIndex extremeIndex(NodeIndex i, int dir) const
+    {
+        if (i == nil)
+            return nil;
+        while (childOf(i, dir) != nil)
+            i = childOf(i, dir);
+        return i;
+    }
+    
+    /// In-order neighbour on side dir (1 for the successor, 0 the predecessor)
+    NodeIndex stepIndex(NodeIndex i, int dir) const
+    {
+        if (childOf(i, dir) != nil)
+            return extremeIndex(childOf(i, dir), !dir);
+        
+        NodeIndex up = parentOf(i);
+        while (up != nil && childOf(up, dir) == i)
+        {
+            i = up;
+            up = parentOf(up);
+        }
+        return up;
+    }
+    
+    NodeIndex nextIndex(NodeIndex i) const
+    {
+        return stepIndex(i, 1);
+    }
+    
+    NodeIndex prevIndex(NodeIndex i) const
+    {
+        return stepIndex(i, 0);
+    }
+    
+    NodeIndex findIndex(const KeyT &key) const;
+    NodeIndex boundIndex(const KeyT &key, bool upper) const;
+    NodeIndex allocateNode(const KeyT &key, const ValueT &value);
+    void rotate(NodeIndex node, int dir);
+    void transplant(NodeIndex oldNode, NodeIndex newNode);
+    void insertFixup(NodeIndex node);
+    void eraseIndex(NodeIndex node);
+    void eraseFixup(NodeIndex node);
+    unsigned int verifySubtree(NodeIndex node, size_t &count) const;
+    
+    std::vector<Node> nodes;    // nodes[0] is the sentinel
+    NodeIndex root;
+    NodeIndex freeList;         // erased slots, chained through child[0]
+    size_t nodeCount;
+    unsigned int blackHeight;
+};
+
+
+
+template <typename KeyT, typename ValueT, typename CompareT>
+typename CompactTreeMap<KeyT, ValueT, CompareT>::NodeIndex
+CompactTreeMap<KeyT, ValueT, CompareT>::findIndex(const KeyT &key) const
+{
+    NodeIndex current = root;
+    
+    while (current != nil)
+    {
+        int compResult = KeyOrder<KeyT, CompareT>::compare(key, nodes[current].key);
+        
+        if (compResult == 0)
+            return current;
+        
+        current = childOf(current, compResult > 0);
+    }
+    
+    return nil;
+}
+
+// Remember the last node where we went left; that's the smallest node that's
+// still >= key (or > key for upper)
+template <typename KeyT, typename ValueT, typename CompareT>
+typename CompactTreeMap<KeyT, ValueT, CompareT>::NodeIndex
+CompactTreeMap<KeyT, ValueT, CompareT>::boundIndex(const KeyT &key, bool upper) const
+{
+    NodeIndex current = root;
+    NodeIndex bound = nil;
+    
+    while (current != nil)
+    {
+        int compResult = KeyOrder<KeyT, CompareT>::compare(key, nodes[current].key);
+        
+        if (compResult < 0 || (compResult == 0 && !upper))
+        {
+            bound = current;
+            current = childOf(current, 0);
+        }
+        else
+        {
+            current = childOf(current, 1);
+        }
+    }
+    
+    return bound;
+}
+
+// Take a slot off the free list, or add one to the end of the array
+template <typename KeyT, typename ValueT, typename CompareT>
+typename CompactTreeMap<KeyT, ValueT, CompareT>::NodeIndex
+CompactTreeMap<KeyT, ValueT, CompareT>::allocateNode(const KeyT &key, const ValueT &value)
+{
+    NodeIndex slot = freeList;
+    
+    if (slot != nil)
+    {
+        freeList = childOf(slot, 0);
+        nodes[slot] = Node(key, value);
+    }
+    else
+    {
+        if (nodes.size() > maxNodes)
+            throw std::length_error("CompactTreeMap is out of node indices");
+        
+        slot = (NodeIndex)nodes.size();
+        nodes.push_back(Node(key, value));
+    }
+    
+    return slot;
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+std::pair<typename CompactTreeMap<KeyT, ValueT, CompareT>::iterator, bool>
+CompactTreeMap<KeyT, ValueT, CompareT>::try_emplace(const KeyT &key, const ValueT &value)
+{
+    NodeIndex current = root;
+    NodeIndex parent = nil;
+    int whichSide = 0;
+    
+    while (current != nil)
+    {
+        int compResult = KeyOrder<KeyT, CompareT>::compare(key, nodes[current].key);
+        
+        if (compResult == 0)
+            return std::make_pair(iterator(this, current), false);
+        
+        parent = current;
+        whichSide = (compResult > 0);
+        current = childOf(current, whichSide);
+    }
+    
+    // Indices only from here on: allocating can move the whole array
+    NodeIndex node = allocateNode(key, value);
+    
+    setParent(node, parent);
+    setRed(node, true);
+    if (parent == nil)
+        root = node;
+    else
+        childOf(parent, whichSide) = node;
+    
+    nodeCount++;
+    insertFixup(node);
+    
+    return std::make_pair(iterator(this, node), true);
+}
+
+// Rotate node down to side dir; its child on the other side takes its place
+template <typename KeyT, typename ValueT, typename CompareT>
+void CompactTreeMap<KeyT, ValueT, CompareT>::rotate(NodeIndex node, int dir)
+{
+    NodeIndex riser = childOf(node, !dir);
+    NodeIndex inner = childOf(riser, dir);
+    NodeIndex parent = parentOf(node);
+    
+    childOf(node, !dir) = inner;
+    if (inner != nil)
+        setParent(inner, node);
+    
+    setParent(riser, parent);
+    if (parent == nil)
+        root = riser;
+    else
+        childOf(parent, sideOf(node, parent)) = riser;
+    
+    childOf(riser, dir) = node;
+    setParent(node, riser);
+}
+
+// Put newNode where oldNode hangs.  newNode can be the sentinel, whose parent
+// then points at oldNode's parent for eraseFixup to start from.
+template <typename KeyT, typename ValueT, typename CompareT>
+void CompactTreeMap<KeyT, ValueT, CompareT>::transplant(NodeIndex oldNode, NodeIndex newNode)
+{
+    NodeIndex parent = parentOf(oldNode);
+    
+    if (parent == nil)
+        root = newNode;
+    else
+        childOf(parent, sideOf(oldNode, parent)) = newNode;
+    
+    setParent(newNode, parent);
+}
+
+// node is new and red.  Push any red-red violation up the tree by recoloring,
+// and settle it with one or two rotations when the uncle is black.
+template <typename KeyT, typename ValueT, typename CompareT>
+void CompactTreeMap<KeyT, ValueT, CompareT>::insertFixup(NodeIndex node)
+{
+    while (isRed(parentOf(node)))
+    {
+        NodeIndex parent = parentOf(node);
+        NodeIndex grandparent = parentOf(parent);
+        int side = sideOf(parent, grandparent);
+        NodeIndex uncle = childOf(grandparent, !side);
+        
+        if (isRed(uncle))
+        {
+            setRed(parent, false);
+            setRed(uncle, false);
+            setRed(grandparent, true);
+            node = grandparent;
+            continue;
+        }
+        
+        if (node == childOf(parent, !side))
+        {
+            node = parent;
+            rotate(node, side);
+            parent = parentOf(node);
+        }
+        
+        setRed(parent, false);
+        setRed(grandparent, true);
+        rotate(grandparent, !side);
+    }
+    
+    // A red root only happens when a split reached the top (or this was the
+    // first node), and blackening it adds a level to every path
+    if (isRed(root))
+    {
+        setRed(root, false);
+        blackHeight++;
+    }
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+void CompactTreeMap<KeyT, ValueT, CompareT>::eraseIndex(NodeIndex node)
+{
+    NodeIndex replacement;
+    bool removedBlack = !isRed(node);
+    
+    if (childOf(node, 0) == nil)
+    {
+        replacement = childOf(node, 1);
+        transplant(node, replacement);
+    }
+    else if (childOf(node, 1) == nil)
+    {
+        replacement = childOf(node, 0);
+        transplant(node, replacement);
+    }
+    else
+    {
+        // Two children: the successor moves into node's place, and it's the
+        // successor's old spot that loses a node
+        NodeIndex successor = extremeIndex(childOf(node, 1), 0);
+        
+        removedBlack = !isRed(successor);
+        replacement = childOf(successor, 1);
+        
+        if (parentOf(successor) == node)
+        {
+            setParent(replacement, successor);
+        }
+        else
+        {
+            transplant(successor, replacement);
+            childOf(successor, 1) = childOf(node, 1);
+            setParent(childOf(successor, 1), successor);
+        }
+        
+        transplant(node, successor);
+        childOf(successor, 0) = childOf(node, 0);
+        setParent(childOf(successor, 0), successor);
+        setRed(successor, isRed(node));
+    }
+    
+    if (removedBlack)
+        eraseFixup(replacement);
+    
+    // Sentinel's parent was only borrowed for the fixup
+    setParent(nil, nil);
+    
+    nodes[node] = Node();
+    childOf(node, 0) = freeList;
+    freeList = node;
+    
+    if (--nodeCount == 0)
+        blackHeight = 0;
+}
+
+// node's paths are one black node short.  Borrow from the sibling's side if it
+// has a red node to give, otherwise shorten the sibling's side too and move up.
+template <typename KeyT, typename ValueT, typename CompareT>
+void CompactTreeMap<KeyT, ValueT, CompareT>::eraseFixup(NodeIndex node)
+{
+    while (node != root && !isRed(node))
+    {
+        NodeIndex parent = parentOf(node);
+        int side = sideOf(node, parent);
+        NodeIndex sibling = childOf(parent, !side);
+        
+        if (isRed(sibling))
+        {
+            setRed(sibling, false);
+            setRed(parent, true);
+            rotate(parent, side);
+            sibling = childOf(parent, !side);
+        }
+        
+        if (!isRed(childOf(sibling, 0)) && !isRed(childOf(sibling, 1)))
+        {
+            setRed(sibling, true);
+            node = parent;
+            
+            // Shortened all the way up: every path lost a black node
+            if (node == root && !isRed(node))
+                blackHeight--;
+            continue;
+        }
+        
+        if (!isRed(childOf(sibling, !side)))
+        {
+            setRed(childOf(sibling, side), false);
+            setRed(sibling, true);
+            rotate(sibling, !side);
+            sibling = childOf(parent, !side);
+        }
+        
+        setRed(sibling, isRed(parent));
+        setRed(parent, false);
+        setRed(childOf(sibling, !side), false);
+        rotate(parent, side);
+        node = root;
+    }
+    
+    setRed(node, false);
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+bool CompactTreeMap<KeyT, ValueT, CompareT>::verifyTree() const
+{
+    size_t count = 0;
+    
+    if (isRed(nil) || childOf(nil, 0) != nil || childOf(nil, 1) != nil)
+        return false;
+    if (root != nil && (isRed(root) || parentOf(root) != nil))
+        return false;
+    
+    unsigned int height = verifySubtree(root, count);
+    
+    return height != 0 && height - 1 == blackHeight && count == nodeCount;
+}
+
+// Black height of the subtree counting the sentinel, or zero if it's broken
+template <typename KeyT, typename ValueT, typename CompareT>
+unsigned int CompactTreeMap<KeyT, ValueT, CompareT>::verifySubtree(NodeIndex node, size_t &count) const
+{
+    if (node == nil)
+        return 1;
+    
+    count++;
+    
+    for (int dir = 0 ; dir < 2 ; dir++)
+    {
+        NodeIndex child = childOf(node, dir);
+        
+        if (child == nil)
+            continue;
+        if (parentOf(child) != node || (isRed(node) && isRed(child)))
+            return 0;
+        
+        int compResult = KeyOrder<KeyT, CompareT>::compare(nodes[child].key, nodes[node].key);
+        if (dir == 0 ? compResult >= 0 : compResult <= 0)
+            return 0;
+    }
+    
+    unsigned int leftHeight = verifySubtree(childOf(node, 0), count);
+    unsigned int rightHeight = verifySubtree(childOf(node, 1), count);
+    
+    if (leftHeight == 0 || leftHeight != rightHeight)
+        return 0;
+    
+    return leftHeight + (isRed(node) ? 0 : 1);
+}
+
+#endif /* defined(__Tree_exercises__CompactTree__) */
@@ -0,0 +1,71 @@
+//
+//  EpochReclaim.cpp
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#include <assert.h>
+
+#include "EpochReclaim.h"
+
+EpochDomain::EpochDomain(unsigned int maxReaders) :
+globalEpoch(0),
+slots(new Slot[maxReaders > 0 ? maxReaders : 1]),
+slotCount(maxReaders > 0 ? maxReaders : 1)
+{
+    for (unsigned int i = 0 ; i < slotCount ; i++)
+    {
+        slots[i].epoch.store(idle, std::memory_order_relaxed);
+        slots[i].inUse.store(false, std::memory_order_relaxed);
+    }
+}
+
+EpochDomain::~EpochDomain()
+{
+    delete [] slots;
+}
+
+unsigned int EpochDomain::join()
+{
+    for (unsigned int i = 0 ; i < slotCount ; i++)
+    {
+        bool expected = false;
+        
+        if (!slots[i].inUse.load(std::memory_order_relaxed) &&
+            slots[i].inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return i;
+    }
+    
+    return noSlot;
+}
+
+void EpochDomain::leave(unsigned int slot)
+{
+    assert(slot < slotCount);
+    
+    slots[slot].epoch.store(idle, std::memory_order_relaxed);
+    slots[slot].inUse.store(false, std::memory_order_release);
+}
+
+// Only the writer calls this, so nobody else moves the epoch and a plain store will do
+bool EpochDomain::tryAdvance()
+{
+    uint64_t epoch = globalEpoch.load(std::memory_order_relaxed);
+    
+    // Pairs with the fence in enter: a reader either shows up pinned here, or
+    // pinned late enough to see everything taken out before now
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    
+    for (unsigned int i = 0 ; i < slotCount ; i++)
+    {
+        uint64_t pinned = slots[i].epoch.load(std::memory_order_acquire);
+        
+        if (pinned != idle && pinned != epoch)
+            return false;
+    }
+    
+    globalEpoch.store(epoch + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,102 @@
+//
+//  EpochReclaim.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__EpochReclaim__
+#define __Tree_exercises__EpochReclaim__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ Epoch based reclamation, for one writer thread and any number of reader threads
+ that follow its pointers without taking a lock.
+ 
+ The writer can take something out of the structure whenever it likes, but can't
+ free it while a reader might still be looking at it.  So it stamps it with the
+ current epoch, and keeps it until the epoch has moved on twice.  Readers pin the
+ epoch they started in for as long as they hold pointers (see enter and exit), and
+ the epoch only moves on once every pinned reader has caught up with it.  Two moves
+ after something was taken out, every reader that could have seen it has finished.
+ 
+ Each reader has its own slot, on its own cache line, so pinning costs a reader a
+ store and a fence and never touches anything another reader writes.  Only the
+ writer reads all the slots, and only when it has a batch of things to free.
+ **/
+class EpochDomain
+{
+public:
+    EpochDomain(unsigned int maxReaders = defaultMaxReaders);
+    ~EpochDomain();
+    
+    /// Claim a slot for a reader thread.  Returns noSlot if all maxReaders are taken.
+    unsigned int join();
+    
+    /// Give a slot back, once the reader's done for good
+    void leave(unsigned int slot);
+    
+    /// Reader side: pin the current epoch before following any pointers...
+    void enter(unsigned int slot)
+    {
+        uint64_t epoch = globalEpoch.load(std::memory_order_acquire);
+        
+        slots[slot].epoch.store(epoch, std::memory_order_relaxed);
+        
+        // The pin has to be visible to the writer before we read anything it could free
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    
+    /// ...and unpin it once none of them are held any more
+    void exit(unsigned int slot)
+    {
+        slots[slot].epoch.store(idle, std::memory_order_release);
+    }
+    
+    /// Writer side: the epoch to stamp things with as they're taken out
+    uint64_t getEpoch() const
+    {
+        return globalEpoch.load(std::memory_order_relaxed);
+    }
+    
+    /// Move the epoch on, if every pinned reader has caught up with it.  Returns
+    /// whether it moved.
+    bool tryAdvance();
+    
+    /// Can something taken out in retiredEpoch be freed?
+    bool isQuiescent(uint64_t retiredEpoch) const
+    {
+        return getEpoch() >= retiredEpoch + 2;
+    }
+    
+    unsigned int getMaxReaders() const
+    {
+        return slotCount;
+    }
+    
+    static const unsigned int defaultMaxReaders = 128;
+    static const unsigned int noSlot = ~0u;
+
+private:
+    static const uint64_t idle = ~(uint64_t)0;   // slot isn't pinning anything
+    
+    /// One reader's slot, a cache line to itself
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch;
+        std::atomic<bool> inUse;
+    };
+    
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+    
+    alignas(64) std::atomic<uint64_t> globalEpoch;
+    Slot *slots;
+    unsigned int slotCount;
+};
+
+#endif /* defined(__Tree_exercises__EpochReclaim__) */
@@ -0,0 +1,478 @@
+//
+//  FrozenBTree.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__FrozenBTree__
+#define __Tree_exercises__FrozenBTree__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FROZEN_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#include "BinaryTree.h"
+#include "FrozenTree.h"
+
+/**
+ Read-only copy of a BinaryTree as a static B+ tree, from BinaryTree::freezeBTree().
+ 
+ Where FrozenTree (a binary layout) makes about log2(n) dependent loads per lookup,
+ this one makes log17(n): every node is one 64 byte cache line holding 16 32-bit
+ key prefixes, and one vector compare against all 16 at once picks which of the 17
+ children to go down to.  That's AVX2 if the CPU has it, picked at runtime like
+ foldMismatch's kernels (see CaseFold.cpp), otherwise SSE2, or a plain loop off x86.
+ The bottom layer is every key's prefix in sorted order; each layer above holds,
+ for each child but the first, the smallest prefix under it.  Layers are stored
+ bottom up in one aligned array.  Building it is one in-order walk of the tree,
+ and then a linear pass per layer.
+ 
+ The 32-bit prefixes come from the node type's 64-bit FrozenPrefix: the offset
+ from the tree's smallest prefix, shifted down just far enough to fit.  Keys
+ whose prefixes tie are sorted out with real compares, by a binary search over
+ the tied run (which is contiguous in the sorted order).  Integer keys spanning
+ less than 2^32 values never tie, so never need one.
+ 
+ Like FrozenTree it points back at the tree's nodes, so it's only good while the
+ tree is there and unchanged.  Positions are ranks, so besides contains and
+ lower_bound/upper_bound it can count a range in O(log n) and scan one from a
+ flat array of node pointers.
+ **/
+template <typename btNodeType, typename BalancePolicy = RedBlackBalance>
+class FrozenBTree
+{
+public:
+    typedef FrozenPrefix<btNodeType> prefixType;
+    typedef typename BinaryTree<btNodeType, BalancePolicy>::const_iterator const_iterator;
+    
+    /// Keys per node: 16 prefixes of 4 bytes, one cache line
+    static const unsigned int blockKeys = 16;
+    
+    explicit FrozenBTree(const BinaryTree<btNodeType, BalancePolicy> &tree) :
+    theTree(nullptr),
+    nodeCount(0),
+    prefixBase(0),
+    prefixShift(0),
+    useAVX2(haveAVX2()),
+    layers(nullptr)
+    {
+        rebuild(tree);
+    }
+    
+    ~FrozenBTree()
+    {
+        free(layers);
+    }
+    
+    FrozenBTree(FrozenBTree &&other) :
+    theTree(other.theTree),
+    nodeCount(other.nodeCount),
+    prefixBase(other.prefixBase),
+    prefixShift(other.prefixShift),
+    useAVX2(other.useAVX2),
+    layers(other.layers),
+    layerOffsets(std::move(other.layerOffsets)),
+    fullPrefixes(std::move(other.fullPrefixes)),
+    sortedNodes(std::move(other.sortedNodes))
+    {
+        other.layers = nullptr;
+        other.nodeCount = 0;
+    }
+    
+    /// Start over from tree, e.g. after it changed, in linear time
+    void rebuild(const BinaryTree<btNodeType, BalancePolicy> &tree);
+    
+    size_t size() const
+    {
+        return nodeCount;
+    }
+    
+    /// Rank of the first node whose key isn't less than key (upper: is greater
+    /// than key), i.e. its index in sorted order, nodeCount if there's none
+    template <typename KeyT>
+    size_t lowerRank(const KeyT &key) const
+    {
+        typename probeFor<btNodeType, KeyT>::type probe(key);
+        bool found;
+        
+        return searchRank(probe, false, found);
+    }
+    
+    template <typename KeyT>
+    size_t upperRank(const KeyT &key) const
+    {
+        typename probeFor<btNodeType, KeyT>::type probe(key);
+        bool found;
+        
+        return searchRank(probe, true, found);
+    }
+    
+    /// Doesn't touch the tree's nodes unless key ties a stored key on its whole
+    /// 64-bit prefix, and then only if that isn't exact
+    template <typename KeyT>
+    bool contains(const KeyT &key) const
+    {
+        typename probeFor<btNodeType, KeyT>::type probe(key);
+        bool found;
+        
+        searchRank(probe, false, found);
+        return found;
+    }
+    
+    /// Node holding key, or nullptr
+    template <typename KeyT>
+    const btNodeType *find(const KeyT &key) const
+    {
+        typename probeFor<btNodeType, KeyT>::type probe(key);
+        bool found;
+        size_t rank = searchRank(probe, false, found);
+        
+        return (found ? sortedNodes[rank] : nullptr);
+    }
+    
+    /// Same answers as the tree's, as iterators into the tree
+    template <typename KeyT>
+    const_iterator lower_bound(const KeyT &key) const
+    {
+        return const_iterator(nodeAt(lowerRank(key)), theTree);
+    }
+    
+    template <typename KeyT>
+    const_iterator upper_bound(const KeyT &key) const
+    {
+        return const_iterator(nodeAt(upperRank(key)), theTree);
+    }
+    
+    /// Number of keys in [lo, hi]
+    template <typename KeyT>
+    size_t countInRange(const KeyT &lo, const KeyT &hi) const
+    {
+        size_t first = lowerRank(lo);
+        size_t last = upperRank(hi);
+        
+        return (last > first ? last - first : 0);
+    }
+    
+    /// Call f(node) for each node with a key in [lo, hi], in order.  Stops early
+    /// if f returns false.  Returns the number of nodes f was called on.
+    template <typename KeyT, typename FuncT>
+    size_t scanRange(const KeyT &lo, const KeyT &hi, FuncT f) const
+    {
+        size_t first = lowerRank(lo);
+        size_t last = upperRank(hi);
+        size_t called = 0;
+        
+        for (size_t rank = first ; rank < last ; rank++)
+        {
+            called++;
+            if (!f(*sortedNodes[rank]))
+                break;
+        }
+        return called;
+    }
+    
+    /// The k-th smallest node, counting from zero, or nullptr
+    const btNodeType *select(size_t k) const
+    {
+        return nodeAt(k);
+    }
+    
+    /// Bytes in the layers and the node pointers (not the nodes)
+    size_t getBytesUsed() const
+    {
+        return layerOffsets.back() * sizeof(int32_t) + fullPrefixes.size() * sizeof(uint64_t) +
+               sortedNodes.size() * sizeof(const btNodeType *);
+    }
+    
+    /// Number of layers, i.e. nodes looked at per lookup
+    unsigned int getHeight() const
+    {
+        return (unsigned int)layerOffsets.size() - 1;
+    }
+
+private:
+    FrozenBTree(const FrozenBTree &) = delete;
+    FrozenBTree &operator=(const FrozenBTree &) = delete;
+    
+    /// Stored prefixes have their top bit flipped, so the signed 32-bit compares
+    /// the vector units have order them as unsigned; this is the largest one, and
+    /// what pads out the last node of each layer
+    static const int32_t paddingKey = INT32_MAX;
+    
+    const btNodeType *nodeAt(size_t rank) const
+    {
+        return (rank < nodeCount ? sortedNodes[rank] : nullptr);
+    }
+    
+    /// Can this CPU run the AVX2 search?  Asked once, the first time a FrozenBTree
+    /// is built.
+    static bool haveAVX2()
+    {
+#ifdef FROZEN_SIMD_X86
+        static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+        
+        return supported;
+#else
+        return false;
+#endif
+    }
+    
+    /// Number of the 16 prefixes in block that are less than key
+    static unsigned int rankInBlock(const int32_t *block, int32_t key)
+    {
+#if defined(FROZEN_SIMD_X86) && defined(__SSE2__)
+        __m128i probe = _mm_set1_epi32(key);
+        __m128i less0 = _mm_cmpgt_epi32(probe, _mm_load_si128((const __m128i *)block));
+        __m128i less1 = _mm_cmpgt_epi32(probe, _mm_load_si128((const __m128i *)(block + 4)));
+        __m128i less2 = _mm_cmpgt_epi32(probe, _mm_load_si128((const __m128i *)(block + 8)));
+        __m128i less3 = _mm_cmpgt_epi32(probe, _mm_load_si128((const __m128i *)(block + 12)));
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(less0, less1), _mm_packs_epi32(less2, less3));
+        
+        return __builtin_popcount((unsigned int)_mm_movemask_epi8(packed));
+#else
+        unsigned int rank = 0;
+        
+        for (unsigned int i = 0 ; i < blockKeys ; i++)
+            rank += (block[i] < key);
+        return rank;
+#endif
+    }
+    
+#ifdef FROZEN_SIMD_X86
+    /// Same, all 16 in one AVX2 compare pair
+    __attribute__((target("avx2")))
+    static unsigned int rankInBlockAVX2(const int32_t *block, int32_t key)
+    {
+        __m256i probe = _mm256_set1_epi32(key);
+        __m256i less0 = _mm256_cmpgt_epi32(probe, _mm256_load_si256((const __m256i *)block));
+        __m256i less1 = _mm256_cmpgt_epi32(probe, _mm256_load_si256((const __m256i *)(block + 8)));
+        unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(less0)) |
+                            ((unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(less1)) << 8);
+        
+        return __builtin_popcount(mask);
+    }
+    
+    /// prefixRank's walk, compiled for AVX2 so rankInBlockAVX2 inlines into it
+    __attribute__((target("avx2")))
+    size_t prefixRankAVX2(int32_t stored) const
+    {
+        size_t block = 0;
+        
+        for (size_t layer = layerOffsets.size() - 2 ; layer > 0 ; layer--)
+        {
+            unsigned int child = rankInBlockAVX2(layers + layerOffsets[layer] + block * blockKeys, stored);
+            block = block * (blockKeys + 1) + child;
+        }
+        
+        size_t rank = block * blockKeys + rankInBlockAVX2(layers + block * blockKeys, stored);
+        return (rank < nodeCount ? rank : nodeCount);
+    }
+#endif
+    
+    /// Where a 64-bit prefix goes among the stored ones: its 32-bit stored form,
+    /// or if it's outside the tree's range altogether, -1 (below) or +1 (above)
+    int narrowPrefix(uint64_t prefix, int32_t &stored) const
+    {
+        if (prefix < prefixBase)
+            return -1;
+        
+        uint64_t offset = (prefix - prefixBase) >> prefixShift;
+        if (offset > UINT32_MAX)
+            return 1;
+        
+        stored = (int32_t)((uint32_t)offset ^ 0x80000000);
+        return 0;
+    }
+    
+    /// Rank of the first stored prefix that isn't less than stored
+    size_t prefixRank(int32_t stored) const
+    {
+#ifdef FROZEN_SIMD_X86
+        if (useAVX2)
+            return prefixRankAVX2(stored);
+#endif
+        
+        size_t block = 0;
+        
+        for (size_t layer = layerOffsets.size() - 2 ; layer > 0 ; layer--)
+        {
+            unsigned int child = rankInBlock(layers + layerOffsets[layer] + block * blockKeys, stored);
+            block = block * (blockKeys + 1) + child;
+        }
+        
+        size_t rank = block * blockKeys + rankInBlock(layers + block * blockKeys, stored);
+        return (rank < nodeCount ? rank : nodeCount);
+    }
+    
+    /// Rank of the first node that isn't less than the probe (upper: that's
+    /// greater).  found says whether the node there holds the probe's key.
+    template <typename ProbeT>
+    size_t searchRank(const ProbeT &probe, bool upper, bool &found) const
+    {
+        assert(theTree->size() == nodeCount);  // the tree changed under us
+        
+        int32_t stored = 0;
+        uint64_t prefix = prefixType::ofProbe(probe);
+        int where = narrowPrefix(prefix, stored);
+        
+        found = false;
+        if (where != 0)
+            return (where < 0 ? 0 : nodeCount);
+        
+        size_t first = prefixRank(stored);
+        
+        // Nothing shares even the narrowed prefix, so that's the answer either way
+        if (first == nodeCount || layers[first] != stored)
+            return first;
+        
+        // Find the end of the run sharing it, galloping since runs are short
+        size_t low = first + 1;
+        size_t last = low;
+        size_t step = 1;
+        
+        while (last < nodeCount && layers[last] == stored)
+        {
+            low = last + 1;
+            step *= 2;
+            last = (step < nodeCount - low ? low + step : nodeCount);
+        }
+        
+        while (low < last)
+        {
+            size_t middle = low + (last - low) / 2;
+            
+            if (layers[middle] == stored)
+                low = middle + 1;
+            else
+                last = middle;
+        }
+        
+        // Then binary search the run: on the full 64-bit prefixes, and only if
+        // those tie and aren't exact, with real compares
+        last = low;
+        while (first < last)
+        {
+            size_t middle = first + (last - first) / 2;
+            int compResult;
+            
+            if (fullPrefixes[middle] != prefix)
+                compResult = (prefix < fullPrefixes[middle] ? -1 : 1);
+            else if (prefixType::exact)
+                compResult = 0;
+            else
+                compResult = sortedNodes[middle]->compareKey(probe);
+            
+            if (compResult == 0)
+                found = true;
+            if (upper ? compResult >= 0 : compResult > 0)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        return first;
+    }
+    
+    const BinaryTree<btNodeType, BalancePolicy> *theTree;
+    size_t nodeCount;
+    uint64_t prefixBase;                        // smallest 64-bit prefix in the tree
+    unsigned int prefixShift;                   // how far offsets from it are shifted down
+    bool useAVX2;                               // search with prefixRankAVX2, see haveAVX2
+    int32_t *layers;                            // bottom layer first, each blockKeys aligned
+    std::vector<size_t> layerOffsets;           // where each layer starts, plus the end
+    std::vector<uint64_t> fullPrefixes;         // the 64-bit prefixes, in sorted order
+    std::vector<const btNodeType *> sortedNodes;
+};
+
+template <typename btNodeType, typename BalancePolicy>
+void FrozenBTree<btNodeType, BalancePolicy>::rebuild(const BinaryTree<btNodeType, BalancePolicy> &tree)
+{
+    theTree = &tree;
+    nodeCount = tree.size();
+    
+    sortedNodes.clear();
+    sortedNodes.reserve(nodeCount);
+    fullPrefixes.clear();
+    fullPrefixes.reserve(nodeCount);
+    for (const_iterator it = tree.begin() ; it != tree.end() ; ++it)
+    {
+        sortedNodes.push_back(it.getNode());
+        fullPrefixes.push_back(prefixType::ofNode(*it.getNode()));
+    }
+    
+    // Fit the spread of 64-bit prefixes into 32 bits
+    prefixBase = (nodeCount > 0 ? fullPrefixes.front() : 0);
+    uint64_t spread = (nodeCount > 0 ? fullPrefixes.back() - prefixBase : 0);
+    
+    prefixShift = 0;
+    while ((spread >> prefixShift) > UINT32_MAX)
+        prefixShift++;
+    
+    // Layer sizes, in blocks: enough to cover the layer below with 17 way nodes
+    layerOffsets.assign(1, 0);
+    size_t blocks = (nodeCount + blockKeys - 1) / blockKeys;
+    if (blocks == 0)
+        blocks = 1;
+    
+    while (true)
+    {
+        layerOffsets.push_back(layerOffsets.back() + blocks * blockKeys);
+        if (blocks == 1)
+            break;
+        blocks = (blocks + blockKeys) / (blockKeys + 1);
+    }
+    
+    free(layers);
+    layers = (int32_t *)aligned_alloc(64, layerOffsets.back() * sizeof(int32_t));
+    if (layers == nullptr)
+        throw std::bad_alloc();
+    
+    for (size_t rank = 0 ; rank < layerOffsets[1] ; rank++)
+    {
+        int32_t stored = paddingKey;
+        
+        if (rank < nodeCount)
+            narrowPrefix(fullPrefixes[rank], stored);
+        layers[rank] = stored;
+    }
+    
+    // Key j of block b in layer h is the smallest prefix under child j + 1, which
+    // is the first key of that child's leftmost bottom layer block
+    size_t span = 1;   // bottom layer blocks under one block of the layer below
+    
+    for (size_t layer = 1 ; layer + 1 < layerOffsets.size() ; layer++)
+    {
+        int32_t *layerKeys = layers + layerOffsets[layer];
+        size_t layerBlocks = (layerOffsets[layer + 1] - layerOffsets[layer]) / blockKeys;
+        
+        for (size_t block = 0 ; block < layerBlocks ; block++)
+        {
+            for (unsigned int j = 0 ; j < blockKeys ; j++)
+            {
+                size_t child = block * (blockKeys + 1) + j + 1;
+                size_t rank = child * span * blockKeys;
+                
+                layerKeys[block * blockKeys + j] = (rank < nodeCount ? layers[rank] : paddingKey);
+            }
+        }
+        
+        span *= blockKeys + 1;
+    }
+}
+
+template <typename btNodeType, typename BalancePolicy>
+FrozenBTree<btNodeType, BalancePolicy> BinaryTree<btNodeType, BalancePolicy>::freezeBTree() const
+{
+    return FrozenBTree<btNodeType, BalancePolicy>(*this);
+}
+
+#endif /* defined(__Tree_exercises__FrozenBTree__) */
@@ -0,0 +1,285 @@
+//
+//  FrozenTree.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__FrozenTree__
+#define __Tree_exercises__FrozenTree__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <assert.h>
+
+#include "BinaryTree.h"
+#include "TreeMap.h"
+
+/// How a node type's keys boil down to a 64-bit integer that orders the same way,
+/// for FrozenTree to search on.  Keys whose prefixes differ compare the way their
+/// prefixes do; keys with equal prefixes are only equal if the prefix is exact,
+/// otherwise it takes a real compare to tell.
+///
+/// Node types that don't say get a prefix of zero, i.e. every step is a real compare.
+template <typename NodeT, typename = void>
+struct FrozenPrefix
+{
+    static const bool exact = false;
+    
+    static uint64_t ofNode(const NodeT &)
+    {
+        return 0;
+    }
+    
+    template <typename ProbeT>
+    static uint64_t ofProbe(const ProbeT &)
+    {
+        return 0;
+    }
+};
+
+/// StringNode, ViewNode and MapNodes over them: the abbreviated key, which their
+/// Probe already works out
+template <typename NodeT>
+struct FrozenPrefix<NodeT, std::void_t<decltype(std::declval<const NodeT &>().getAbbrevKey()),
+                                       typename NodeT::Probe> >
+{
+    static const bool exact = false;
+    
+    static uint64_t ofNode(const NodeT &node)
+    {
+        return node.getAbbrevKey();
+    }
+    
+    static uint64_t ofProbe(const typename NodeT::Probe &probe)
+    {
+        return probe.abbrevKey;
+    }
+};
+
+/// TreeMap nodes with integer keys in their natural order (either way round):
+/// the key itself, sign bit flipped if it's signed so it orders as unsigned
+template <typename KeyT, typename ValueT, typename CompareT>
+struct FrozenPrefix<TreeMapNode<KeyT, ValueT, CompareT>,
+                    typename std::enable_if<std::is_integral<KeyT>::value &&
+                                            (isAscending<KeyT, CompareT>::value || isDescending<KeyT, CompareT>::value)>::type>
+{
+    static const bool exact = true;
+    
+    static uint64_t ofKey(const KeyT &key)
+    {
+        uint64_t bits = (uint64_t)(typename std::conditional<std::is_signed<KeyT>::value, int64_t, uint64_t>::type)key;
+        
+        if (std::is_signed<KeyT>::value)
+            bits ^= (uint64_t)1 << 63;
+        return (isDescending<KeyT, CompareT>::value ? ~bits : bits);
+    }
+    
+    static uint64_t ofNode(const TreeMapNode<KeyT, ValueT, CompareT> &node)
+    {
+        return ofKey(node.getKey());
+    }
+    
+    static uint64_t ofProbe(const KeyT &key)
+    {
+        return ofKey(key);
+    }
+};
+
+/**
+ Read-only copy of a BinaryTree laid out for searching, from BinaryTree::freeze().
+ 
+ The nodes' key prefixes (see FrozenPrefix) go into one flat array in Eytzinger
+ order: the root in slot 1, and the children of slot k in slots 2k and 2k+1, so
+ a search just walks down the array, and the top levels, which every search goes
+ through, share the first few cache lines.  The walk has no branches to mispredict
+ (k = 2k + (slot k < key)), and prefetches the slots three levels further down,
+ which all sit in the one cache line, while it works on this one.  The original
+ node is only looked at when prefixes tie, and for exact prefixes (integer keys)
+ not even then.
+ 
+ Lookups answer the way the tree's do: find returns the node holding the key,
+ lower_bound and upper_bound return iterators into the tree.  That's because the
+ frozen copy points back at the tree's nodes, so it's only good while the tree is
+ there and unchanged; it's for trees that are built once and then only read.
+ **/
+template <typename btNodeType, typename BalancePolicy = RedBlackBalance>
+class FrozenTree
+{
+public:
+    typedef FrozenPrefix<btNodeType> prefixType;
+    typedef typename BinaryTree<btNodeType, BalancePolicy>::const_iterator const_iterator;
+    
+    explicit FrozenTree(const BinaryTree<btNodeType, BalancePolicy> &tree);
+    
+    ~FrozenTree()
+    {
+        free(prefixes);
+        free(nodes);
+    }
+    
+    FrozenTree(FrozenTree &&other) :
+    theTree(other.theTree),
+    nodeCount(other.nodeCount),
+    prefixes(other.prefixes),
+    nodes(other.nodes)
+    {
+        other.prefixes = nullptr;
+        other.nodes = nullptr;
+        other.nodeCount = 0;
+    }
+    
+    size_t size() const
+    {
+        return nodeCount;
+    }
+    
+    /// Node holding key, or nullptr
+    template <typename KeyT>
+    const btNodeType *find(const KeyT &key) const
+    {
+        typename probeFor<btNodeType, KeyT>::type probe(key);
+        uint64_t prefix = prefixType::ofProbe(probe);
+        size_t slot = searchSlot(probe, prefix, false);
+        
+        if (slot == 0 || prefixes[slot] != prefix)
+            return nullptr;
+        if (!prefixType::exact && nodes[slot]->compareKey(probe) != 0)
+            return nullptr;
+        return nodes[slot];
+    }
+    
+    template <typename KeyT>
+    bool contains(const KeyT &key) const
+    {
+        return find(key) != nullptr;
+    }
+    
+    /// First node whose key isn't less than key, as an iterator into the tree
+    template <typename KeyT>
+    const_iterator lower_bound(const KeyT &key) const
+    {
+        typename probeFor<btNodeType, KeyT>::type probe(key);
+        
+        return const_iterator(nodes[searchSlot(probe, prefixType::ofProbe(probe), false)], theTree);
+    }
+    
+    /// First node whose key is greater than key
+    template <typename KeyT>
+    const_iterator upper_bound(const KeyT &key) const
+    {
+        typename probeFor<btNodeType, KeyT>::type probe(key);
+        
+        return const_iterator(nodes[searchSlot(probe, prefixType::ofProbe(probe), true)], theTree);
+    }
+    
+    /// Bytes in the frozen arrays (the nodes they point back to not included)
+    size_t getBytesUsed() const
+    {
+        return (nodeCount + 1) * (sizeof(uint64_t) + sizeof(const btNodeType *));
+    }
+
+private:
+    FrozenTree(const FrozenTree &) = delete;
+    FrozenTree &operator=(const FrozenTree &) = delete;
+    
+    /// Slot k's descendants three levels down are slots 8k to 8k+7: eight
+    /// prefixes, exactly one (aligned) cache line, so one prefetch gets them all
+    static const size_t prefetchStride = 8;
+    
+    void fillSlots(size_t slot, const_iterator &it);
+    
+    /// Does the node in slot sort before the probe (upper: before or with it)?
+    template <typename ProbeT>
+    bool slotBefore(size_t slot, const ProbeT &probe, uint64_t prefix, bool upper) const
+    {
+        if (prefixType::exact)
+            return (prefixes[slot] < prefix) | ((prefixes[slot] == prefix) & upper);
+        if (prefixes[slot] != prefix)
+            return prefixes[slot] < prefix;
+        
+        int compResult = nodes[slot]->compareKey(probe);
+        return (upper ? compResult >= 0 : compResult > 0);
+    }
+    
+    /// The slot of the first node that doesn't sort before the probe, or 0 if
+    /// there isn't one.  Going down, every step right sets a low bit in slot; the
+    /// answer is where we last went left, i.e. slot with its trailing ones and the
+    /// zero above them shifted out.
+    template <typename ProbeT>
+    size_t searchSlot(const ProbeT &probe, uint64_t prefix, bool upper) const
+    {
+        assert(theTree->size() == nodeCount);  // the tree changed under us
+        
+        size_t slot = 1;
+        
+        while (slot <= nodeCount)
+        {
+            __builtin_prefetch(prefixes + slot * prefetchStride);
+            slot = 2 * slot + slotBefore(slot, probe, prefix, upper);
+        }
+        
+        return slot >> __builtin_ffsll(~slot);
+    }
+    
+    const BinaryTree<btNodeType, BalancePolicy> *theTree;
+    size_t nodeCount;
+    uint64_t *prefixes;             // slots 1..nodeCount, cache line aligned
+    const btNodeType **nodes;       // slot 0 is nullptr, for "not found"
+};
+
+template <typename btNodeType, typename BalancePolicy>
+FrozenTree<btNodeType, BalancePolicy>::FrozenTree(const BinaryTree<btNodeType, BalancePolicy> &tree) :
+theTree(&tree),
+nodeCount(tree.size()),
+prefixes(nullptr),
+nodes(nullptr)
+{
+    size_t slots = nodeCount + 1;
+    size_t prefixBytes = (slots * sizeof(uint64_t) + 63) & ~(size_t)63;
+    
+    prefixes = (uint64_t *)aligned_alloc(64, prefixBytes);
+    nodes = (const btNodeType **)malloc(slots * sizeof(const btNodeType *));
+    if (prefixes == nullptr || nodes == nullptr)
+    {
+        free(prefixes);
+        free(nodes);
+        throw std::bad_alloc();
+    }
+    
+    prefixes[0] = 0;
+    nodes[0] = nullptr;
+    
+    // An in-order walk of the tree visits the nodes in the order an in-order walk
+    // of the implicit Eytzinger tree visits slots, so pair them up as we go
+    const_iterator it = tree.begin();
+    
+    fillSlots(1, it);
+}
+
+template <typename btNodeType, typename BalancePolicy>
+void FrozenTree<btNodeType, BalancePolicy>::fillSlots(size_t slot, const_iterator &it)
+{
+    if (slot > nodeCount)
+        return;
+    
+    fillSlots(2 * slot, it);
+    
+    nodes[slot] = it.getNode();
+    prefixes[slot] = prefixType::ofNode(*it.getNode());
+    ++it;
+    
+    fillSlots(2 * slot + 1, it);
+}
+
+template <typename btNodeType, typename BalancePolicy>
+FrozenTree<btNodeType, BalancePolicy> BinaryTree<btNodeType, BalancePolicy>::freeze() const
+{
+    return FrozenTree<btNodeType, BalancePolicy>(*this);
+}
+
+#endif /* defined(__Tree_exercises__FrozenTree__) */
@@ -0,0 +1,293 @@
+//
+//  LineIndex.cpp
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include "LineIndex.h"
+
+/// What's at the front of a saved index, followed by the line starts and then
+/// the line lengths
+struct LineIndexHeader
+{
+    char magic[8];
+    uint64_t fileSize;
+    int64_t modifiedSeconds;
+    int64_t modifiedNanoseconds;
+    uint64_t lineCount;
+};
+
+static const char lineIndexMagic[8] = { 'L', 'I', 'N', 'E', 'I', 'D', 'X', '1' };
+
+/// Fill in the parts of the header that say which version of the file it's for
+static bool describeFile(const char *path, LineIndexHeader &header)
+{
+    struct stat buf;
+    
+    if (stat(path, &buf) < 0)
+        return false;
+    
+    memcpy(header.magic, lineIndexMagic, sizeof(header.magic));
+    header.fileSize = (uint64_t)buf.st_size;
+#ifdef __APPLE__
+    header.modifiedSeconds = buf.st_mtimespec.tv_sec;
+    header.modifiedNanoseconds = buf.st_mtimespec.tv_nsec;
+#else
+    header.modifiedSeconds = buf.st_mtim.tv_sec;
+    header.modifiedNanoseconds = buf.st_mtim.tv_nsec;
+#endif
+    
+    return true;
+}
+
+LineIndex::LineIndex() : fileData(nullptr)
+{
+    
+}
+
+void LineIndex::build(const MappedFile &file)
+{
+    fileData = file.data();
+    lineStarts.clear();
+    lineLengths.clear();
+    
+    file.forEachLine([this](std::string_view line)
+                     {
+                         lineStarts.push_back(line.data() - fileData);
+                         lineLengths.push_back((uint32_t)line.length());
+                     });
+    
+    lineStarts.shrink_to_fit();
+    lineLengths.shrink_to_fit();
+}
+
+void LineIndex::openFor(const char *path, const MappedFile &file)
+{
+    std::string indexPath = indexPathFor(path);
+    
+    if (load(indexPath.c_str(), path, file))
+        return;
+    
+    build(file);
+    save(indexPath.c_str(), path);
+}
+
+bool LineIndex::save(const char *indexPath, const char *path) const
+{
+    LineIndexHeader header;
+    
+    if (!describeFile(path, header))
+        return false;
+    header.lineCount = lineStarts.size();
+    
+    // Write to the side and rename, so nobody ever reads half an index
+    std::string tempPath = std::string(indexPath) + ".tmp";
+    FILE *out = fopen(tempPath.c_str(), "wb");
+    if (out == nullptr)
+        return false;
+    
+    bool written = (fwrite(&header, sizeof(header), 1, out) == 1 &&
+                    fwrite(lineStarts.data(), sizeof(uint64_t), lineStarts.size(), out) == lineStarts.size() &&
+                    fwrite(lineLengths.data(), sizeof(uint32_t), lineLengths.size(), out) == lineLengths.size());
+    
+    if (fclose(out) != 0 || !written || rename(tempPath.c_str(), indexPath) != 0)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    
+    return true;
+}
+
+bool LineIndex::load(const char *indexPath, const char *path, const MappedFile &file)
+{
+    LineIndexHeader expected;
+    LineIndexHeader header;
+    
+    if (!describeFile(path, expected) || expected.fileSize != file.size())
+        return false;
+    
+    FILE *in = fopen(indexPath, "rb");
+    if (in == nullptr)
+        return false;
+    
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.fileSize != expected.fileSize ||
+        header.modifiedSeconds != expected.modifiedSeconds ||
+        header.modifiedNanoseconds != expected.modifiedNanoseconds ||
+        header.lineCount > header.fileSize)
+    {
+        fclose(in);
+        return false;
+    }
+    
+    std::vector<uint64_t> starts(header.lineCount);
+    std::vector<uint32_t> lengths(header.lineCount);
+    
+    bool complete = (fread(starts.data(), sizeof(uint64_t), starts.size(), in) == starts.size() &&
+                     fread(lengths.data(), sizeof(uint32_t), lengths.size(), in) == lengths.size());
+    fclose(in);
+    
+    if (!complete)
+        return false;
+    
+    // Don't trust anything pointing outside the file (checked so a huge start
+    // can't wrap around)
+    for (size_t i = 0 ; i < starts.size() ; i++)
+    {
+        if (starts[i] > file.size() || lengths[i] > file.size() - starts[i])
+            return false;
+    }
+    
+    fileData = file.data();
+    lineStarts.swap(starts);
+    lineLengths.swap(lengths);
+    
+    return true;
+}
+
+LineSampler::LineSampler(const LineIndex &lineIndex, bool withReplacement, uint64_t seed) :
+index(lineIndex),
+replacement(withReplacement),
+weighted(false),
+engine(seed),
+drawn(0)
+{
+    if (!replacement)
+    {
+        order.resize(index.size());
+        for (size_t i = 0 ; i < order.size() ; i++)
+            order[i] = (uint32_t)i;
+    }
+}
+
+LineSampler::LineSampler(const LineIndex &lineIndex, const std::vector<double> &weights,
+                         bool withReplacement, uint64_t seed) :
+index(lineIndex),
+replacement(withReplacement),
+weighted(true),
+engine(seed),
+drawn(0)
+{
+    assert(weights.size() == index.size());
+    
+    if (replacement)
+        buildAliasTable(weights);
+    else
+        buildWeightedOrder(weights);
+}
+
+size_t LineSampler::nextIndex()
+{
+    if (index.size() == 0)
+        return 0;
+    
+    if (replacement)
+    {
+        size_t column = std::uniform_int_distribution<size_t>(0, index.size() - 1)(engine);
+        
+        if (!weighted)
+            return column;
+        
+        // Alias method: pick a column, then it or its alias
+        return (std::uniform_real_distribution<double>(0.0, 1.0)(engine) < aliasProbability[column] ? column : alias[column]);
+    }
+    
+    if (drawn >= order.size())
+        return index.size();
+    
+    // Weighted orders are all drawn already.  Uniform ones do one more step of
+    // Fisher-Yates: swap a random line from the rest into the next spot.
+    if (!weighted)
+    {
+        size_t pick = std::uniform_int_distribution<size_t>(drawn, order.size() - 1)(engine);
+        std::swap(order[drawn], order[pick]);
+    }
+    
+    return order[drawn++];
+}
+
+// Vose's alias method.  Scale the weights so they average 1, then pair every
+// column that's under 1 with one that's over, which tops it up.
+void LineSampler::buildAliasTable(const std::vector<double> &weights)
+{
+    size_t count = weights.size();
+    double total = 0.0;
+    
+    for (double weight : weights)
+        total += weight;
+    
+    aliasProbability.resize(count);
+    alias.resize(count);
+    
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    
+    for (size_t i = 0 ; i < count ; i++)
+    {
+        aliasProbability[i] = (total > 0.0 ? weights[i] * count / total : 1.0);
+        alias[i] = (uint32_t)i;
+        
+        if (aliasProbability[i] < 1.0)
+            small.push_back((uint32_t)i);
+        else
+            large.push_back((uint32_t)i);
+    }
+    
+    while (!small.empty() && !large.empty())
+    {
+        uint32_t under = small.back();
+        uint32_t over = large.back();
+        
+        small.pop_back();
+        alias[under] = over;
+        aliasProbability[over] -= 1.0 - aliasProbability[under];
+        
+        if (aliasProbability[over] < 1.0)
+        {
+            large.pop_back();
+            small.push_back(over);
+        }
+    }
+    
+    // Whatever's left is 1, give or take rounding
+    for (uint32_t column : small)
+        aliasProbability[column] = 1.0;
+    for (uint32_t column : large)
+        aliasProbability[column] = 1.0;
+}
+
+// Efraimidis-Spirakis: give each line the key u^(1/weight) and take them largest
+// key first.  Done in log space, log(u)/weight, so tiny weights don't underflow.
+// Lines with no weight never come up.
+void LineSampler::buildWeightedOrder(const std::vector<double> &weights)
+{
+    std::vector<std::pair<double, uint32_t> > keys;
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    
+    keys.reserve(weights.size());
+    for (size_t i = 0 ; i < weights.size() ; i++)
+    {
+        if (weights[i] > 0.0)
+            keys.push_back(std::make_pair(std::log(1.0 - unit(engine)) / weights[i], (uint32_t)i));
+    }
+    
+    std::sort(keys.begin(), keys.end(), [](const std::pair<double, uint32_t> &lhs, const std::pair<double, uint32_t> &rhs)
+              {
+                  return lhs.first > rhs.first;
+              });
+    
+    order.resize(keys.size());
+    for (size_t i = 0 ; i < keys.size() ; i++)
+        order[i] = keys[i].second;
+}
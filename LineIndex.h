@@ -0,0 +1,119 @@
+//
+//  LineIndex.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__LineIndex__
+#define __Tree_exercises__LineIndex__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <random>
+
+#include "MappedFile.h"
+
+/// Where every non-empty line in a MappedFile starts, and how long it is, so line
+/// i can be had in O(1).  Built in one pass over the file, and can be saved next
+/// to it (as path.lines) so the next run doesn't even need the one pass.
+class LineIndex
+{
+public:
+    LineIndex();
+    
+    /// Index file is a MappedFile, built in one pass
+    void build(const MappedFile &file);
+    
+    /// Use the saved index for the file at path if there is one and it's still
+    /// current, otherwise build one and try to save it (not being able to, e.g.
+    /// in a read-only directory, isn't an error).  file has to be path, mapped.
+    void openFor(const char *path, const MappedFile &file);
+    
+    /// Save or load the index to or from indexPath.  The index remembers the size
+    /// and modification time of the file at path, and load() refuses an index
+    /// that doesn't match any more.  Both return false on failure.
+    bool save(const char *indexPath, const char *path) const;
+    bool load(const char *indexPath, const char *path, const MappedFile &file);
+    
+    static std::string indexPathFor(const char *path)
+    {
+        return std::string(path) + ".lines";
+    }
+    
+    size_t size() const
+    {
+        return lineStarts.size();
+    }
+    
+    std::string_view operator[](size_t line) const
+    {
+        return std::string_view(fileData + lineStarts[line], lineLengths[line]);
+    }
+    
+private:
+    const char *fileData;
+    std::vector<uint64_t> lineStarts;   // byte offsets into the file
+    std::vector<uint32_t> lineLengths;  // without the line end
+};
+
+/// Random lines from a LineIndex, all equally likely (or in proportion to a weight
+/// per line), with or without replacement.  Unlike picking a random byte and
+/// backing up to a line start, long lines aren't favored.
+///
+/// With replacement, every draw is O(1), weighted or not (weights use Vose's alias
+/// method).  Without replacement, uniform draws are a lazy Fisher-Yates shuffle,
+/// O(1) each, and weighted ones draw the whole order up front (Efraimidis-Spirakis),
+/// O(n log n) once.  Same seed, same stream.
+class LineSampler
+{
+public:
+    LineSampler(const LineIndex &lineIndex, bool withReplacement, uint64_t seed);
+    
+    /// weights has one entry per line, and they don't need to add up to anything
+    LineSampler(const LineIndex &lineIndex, const std::vector<double> &weights,
+                bool withReplacement, uint64_t seed);
+    
+    /// Index of the next line drawn.  Without replacement, returns index.size()
+    /// once every line has been drawn.
+    size_t nextIndex();
+    
+    /// The next line drawn, false when there are none left
+    bool next(std::string_view &line)
+    {
+        size_t lineNumber = nextIndex();
+        
+        if (lineNumber >= index.size())
+            return false;
+        
+        line = index[lineNumber];
+        return true;
+    }
+    
+    /// How many more draws there are without replacement (forever, otherwise)
+    size_t remaining() const
+    {
+        return (replacement ? SIZE_MAX : order.size() - drawn);
+    }
+    
+private:
+    void buildAliasTable(const std::vector<double> &weights);
+    void buildWeightedOrder(const std::vector<double> &weights);
+    
+    const LineIndex &index;
+    bool replacement;
+    bool weighted;
+    std::mt19937_64 engine;
+    
+    std::vector<uint32_t> order;        // without replacement: the shuffle so far
+    size_t drawn;
+    
+    std::vector<double> aliasProbability;   // weighted with replacement
+    std::vector<uint32_t> alias;
+};
+
+#endif /* defined(__Tree_exercises__LineIndex__) */
@@ -0,0 +1,63 @@
+//
+//  MapNode.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__MapNode__
+#define __Tree_exercises__MapNode__
+
+#include <type_traits>
+#include <utility>
+
+#include "NodeArena.h"
+
+/// A key node (StringNode, ViewNode, ...) with a value riding along, which turns
+/// BinaryTree<MapNode<KeyNodeT, ValueT>> into a map.  Keys order, compare and look
+/// up exactly like they do in KeyNodeT; the value plays no part in any of that, so
+/// it can be changed in place, e.g. tree.find(word)->getMapped()++.
+///
+/// Build them with BinaryTree::try_emplace or insert_or_assign, which only make a
+/// node once they know the key isn't there yet.
+template <typename KeyNodeT, typename ValueT>
+class MapNode : public KeyNodeT
+{
+public:
+    typedef ValueT mapped_type;
+    
+    /// Arena constructor, for BinaryTree::createNode.  The key goes to KeyNodeT,
+    /// anything after it to ValueT's constructor.
+    template <typename KeyArgT, typename... ValueArgs>
+    MapNode(NodeArena &arena, const KeyArgT &key, ValueArgs&&... valueArgs) :
+    KeyNodeT(arena, key),
+    mappedValue(std::forward<ValueArgs>(valueArgs)...)
+    {
+        
+    }
+    
+    /// Only droppable with the arena if the value doesn't need destroying either
+    static const bool trivialArenaTeardown = KeyNodeT::trivialArenaTeardown && std::is_trivially_destructible<ValueT>::value;
+    
+    ValueT &getMapped()
+    {
+        return mappedValue;
+    }
+    
+    const ValueT &getMapped() const
+    {
+        return mappedValue;
+    }
+    
+    template <typename ArgT>
+    void setMapped(ArgT &&value)
+    {
+        mappedValue = std::forward<ArgT>(value);
+    }
+    
+private:
+    ValueT mappedValue;
+};
+
+#endif /* defined(__Tree_exercises__MapNode__) */
@@ -0,0 +1,97 @@
+//
+//  MappedFile.cpp
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile() :
+fileData(nullptr),
+fileSize(0),
+opened(false)
+{
+    
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *path)
+{
+    close();
+    
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    
+    struct stat buf;
+    if (fstat(fd, &buf) < 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    
+    // Can't map nothing, but an empty file is still a file
+    if (buf.st_size > 0)
+    {
+        void *mapping = mmap(nullptr, (size_t)buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        
+        if (mapping == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        
+        // We're about to read the whole thing, get the kernel started on it
+        madvise(mapping, (size_t)buf.st_size, MADV_WILLNEED);
+        
+        fileData = (const char *)mapping;
+        fileSize = (size_t)buf.st_size;
+    }
+    
+    // The mapping stays valid without the descriptor
+    ::close(fd);
+    opened = true;
+    
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (fileData != nullptr)
+        munmap((void *)fileData, fileSize);
+    
+    fileData = nullptr;
+    fileSize = 0;
+    opened = false;
+}
+
+std::vector<std::string_view> MappedFile::lines() const
+{
+    std::vector<std::string_view> allLines;
+    
+    // One pass to count, so the vector is sized once rather than regrown
+    const char *end = fileData + fileSize;
+    size_t lineCount = 1;
+    
+    for (const char *p = fileData ; p < end && (p = (const char *)memchr(p, '\n', end - p)) != nullptr ; p++)
+        lineCount++;
+    
+    allLines.reserve(lineCount);
+    forEachLine([&allLines](std::string_view line)
+                {
+                    allLines.push_back(line);
+                });
+    
+    return allLines;
+}
@@ -0,0 +1,88 @@
+//
+//  MappedFile.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__MappedFile__
+#define __Tree_exercises__MappedFile__
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+/// A whole file mapped read-only into memory.  Reading a dictionary this way
+/// costs no copies at all: the lines come back as string_views pointing straight
+/// into the mapping, and a ViewNode can use one of those as its key as is.
+/// Anything holding such a view has to be gone before the MappedFile is.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    
+    /// Map the file at path, replacing whatever was mapped before.  Returns false
+    /// (with errno set) if it can't be opened or mapped.
+    bool open(const char *path);
+    
+    void close();
+    
+    bool isOpen() const
+    {
+        return opened;
+    }
+    
+    const char *data() const
+    {
+        return fileData;
+    }
+    
+    size_t size() const
+    {
+        return fileSize;
+    }
+    
+    std::string_view contents() const
+    {
+        return std::string_view(fileData, fileSize);
+    }
+    
+    /// Call f(string_view) with each non-empty line, minus its line end (\n or \r\n)
+    template <typename FuncT>
+    void forEachLine(FuncT f) const
+    {
+        const char *cursor = fileData;
+        const char *end = fileData + fileSize;
+        
+        while (cursor < end)
+        {
+            const char *newline = (const char *)memchr(cursor, '\n', end - cursor);
+            const char *lineEnd = (newline != nullptr ? newline : end);
+            size_t length = lineEnd - cursor;
+            
+            if (length > 0 && cursor[length - 1] == '\r')
+                length--;
+            
+            if (length > 0)
+                f(std::string_view(cursor, length));
+            
+            cursor = lineEnd + 1;
+        }
+    }
+    
+    /// All the non-empty lines, in file order
+    std::vector<std::string_view> lines() const;
+    
+private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    
+    const char *fileData;
+    size_t fileSize;
+    bool opened;
+};
+
+#endif /* defined(__Tree_exercises__MappedFile__) */
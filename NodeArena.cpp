@@ -0,0 +1,83 @@
+//
+//  NodeArena.cpp
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#include <cstdlib>
+#include <new>
+
+#include "NodeArena.h"
+
+NodeArena::NodeArena(size_t firstSlabSize) :
+slabs(nullptr),
+cursor(nullptr),
+limit(nullptr),
+nextSlabSize(firstSlabSize),
+bytesUsed(0),
+bytesReserved(0),
+bytesFree(0)
+{
+    memset(freeBlocks, 0, sizeof(freeBlocks));
+}
+
+NodeArena::~NodeArena()
+{
+    clear();
+}
+
+void NodeArena::clear()
+{
+    while (slabs != nullptr)
+    {
+        Slab *next = slabs->next;
+        free(slabs);
+        slabs = next;
+    }
+    
+    cursor = limit = nullptr;
+    bytesUsed = bytesReserved = bytesFree = 0;
+    memset(freeBlocks, 0, sizeof(freeBlocks));
+}
+
+bool NodeArena::owns(const void *ptr) const
+{
+    const char *p = (const char *)ptr;
+    
+    for (const Slab *slab = slabs ; slab != nullptr ; slab = slab->next)
+    {
+        const char *start = (const char *)(slab + 1);
+        
+        if (p >= start && p < start + slab->size)
+            return true;
+    }
+    
+    return false;
+}
+
+// Current slab is full (or there isn't one yet).  Start a new one big enough
+// for this request, and double the size for next time.
+void *NodeArena::allocateFromNewSlab(size_t bytes, size_t alignment)
+{
+    size_t slabSize = nextSlabSize;
+    
+    while (slabSize < bytes + alignment)
+        slabSize *= 2;
+    
+    Slab *slab = (Slab *)malloc(sizeof(Slab) + slabSize);
+    if (slab == nullptr)
+        throw std::bad_alloc();
+    
+    slab->next = slabs;
+    slab->size = slabSize;
+    slabs = slab;
+    
+    cursor = (char *)(slab + 1);
+    limit = cursor + slabSize;
+    nextSlabSize = slabSize * 2;
+    bytesReserved += slabSize;
+    
+    return allocate(bytes, alignment);
+}
@@ -0,0 +1,167 @@
+//
+//  NodeArena.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__NodeArena__
+#define __Tree_exercises__NodeArena__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <assert.h>
+
+/// Bump allocator for tree nodes and their key bytes.
+///
+/// Memory is carved out of big slabs, back to back, so nodes built one after
+/// the other end up next to each other, and there's no per-allocation malloc
+/// header or fragmentation.  Slabs are only freed all at once, when the arena goes
+/// away (or is cleared).  Each new slab is twice the size of the last, so even a
+/// huge tree only has a few dozen of them.
+///
+/// Key bytes can be handed back one block at a time, though, so a tree that keeps
+/// erasing and inserting doesn't keep growing: released blocks go on a free list
+/// for their size class, and the next key of that class reuses one.  Classes are
+/// every multiple of 8 bytes up to 256, then powers of two.
+class NodeArena
+{
+public:
+    NodeArena(size_t firstSlabSize = defaultSlabSize);
+    ~NodeArena();
+    
+    /// Get bytes from the arena, aligned to alignment (a power of two)
+    void *allocate(size_t bytes, size_t alignment)
+    {
+        uintptr_t aligned = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        
+        if (cursor == nullptr || aligned + bytes > (uintptr_t)limit)
+            return allocateFromNewSlab(bytes, alignment);
+        
+        cursor = (char *)(aligned + bytes);
+        bytesUsed += bytes;
+        return (void *)aligned;
+    }
+    
+    /// Get bytes (unaligned) that can be given back with releaseBytes.  A block
+    /// of the same size class that was given back is reused first.
+    void *allocateBytes(size_t bytes)
+    {
+        unsigned int sizeClass;
+        size_t blockBytes = classBytes(bytes, sizeClass);
+        char *block = freeBlocks[sizeClass];
+        
+        if (block == nullptr)
+            return allocate(blockBytes, 1);
+        
+        // The link to the next free block is kept in the block itself, unaligned
+        memcpy(&freeBlocks[sizeClass], block, sizeof(char *));
+        bytesFree -= blockBytes;
+        return block;
+    }
+    
+    /// Give back a block from allocateBytes, of the same byte count as was asked for
+    void releaseBytes(void *block, size_t bytes)
+    {
+        unsigned int sizeClass;
+        size_t blockBytes = classBytes(bytes, sizeClass);
+        
+        assert(owns(block));
+        memcpy(block, &freeBlocks[sizeClass], sizeof(char *));
+        freeBlocks[sizeClass] = (char *)block;
+        bytesFree += blockBytes;
+    }
+    
+    /// Copy a string into the arena, NUL terminated
+    const char *copyString(const char *str, size_t length)
+    {
+        char *copy = (char *)allocateBytes(length + 1);
+        memcpy(copy, str, length);
+        copy[length] = '\0';
+        return copy;
+    }
+    
+    /// Give back a copyString copy of length bytes
+    void releaseString(const char *str, size_t length)
+    {
+        releaseBytes(const_cast<char *>(str), length + 1);
+    }
+    
+    /// Did this pointer come from this arena?  Walks the slab list, which is short
+    bool owns(const void *ptr) const;
+    
+    /// Hand back every slab.  Anything allocated from the arena is gone after this.
+    void clear();
+    
+    size_t getBytesUsed() const
+    {
+        return bytesUsed;
+    }
+    
+    size_t getBytesReserved() const
+    {
+        return bytesReserved;
+    }
+    
+    /// Bytes given back with releaseBytes and not reused yet
+    size_t getBytesFree() const
+    {
+        return bytesFree;
+    }
+    
+    static const size_t defaultSlabSize = 64 * 1024;
+    
+private:
+    /// Slab header, the slab's memory follows it directly
+    struct Slab
+    {
+        Slab *next;
+        size_t size;
+    };
+    
+    NodeArena(const NodeArena &) = delete;
+    NodeArena &operator=(const NodeArena &) = delete;
+    
+    void *allocateFromNewSlab(size_t bytes, size_t alignment);
+    
+    static const size_t classGranule = 8;       // also the smallest block, room for the free list link
+    static const size_t smallClassLimit = 256;  // multiples of classGranule up to here, powers of two above
+    static const unsigned int smallClasses = smallClassLimit / classGranule;
+    static const unsigned int sizeClassCount = smallClasses + 64;
+    
+    /// The block size bytes gets rounded up to, and its size class
+    static size_t classBytes(size_t bytes, unsigned int &sizeClass)
+    {
+        if (bytes <= smallClassLimit)
+        {
+            size_t blockBytes = (bytes < classGranule ? classGranule : (bytes + classGranule - 1) & ~(classGranule - 1));
+            
+            sizeClass = (unsigned int)(blockBytes / classGranule) - 1;
+            return blockBytes;
+        }
+        
+        size_t blockBytes = smallClassLimit * 2;
+        
+        sizeClass = smallClasses;
+        while (blockBytes < bytes)
+        {
+            blockBytes *= 2;
+            sizeClass++;
+        }
+        
+        return blockBytes;
+    }
+    
+    Slab *slabs;          // most recent first
+    char *cursor;         // next free byte in the current slab
+    char *limit;          // end of the current slab
+    size_t nextSlabSize;
+    size_t bytesUsed;
+    size_t bytesReserved;
+    size_t bytesFree;
+    char *freeBlocks[sizeClassCount];   // released key blocks, one list per size class
+};
+
+#endif /* defined(__Tree_exercises__NodeArena__) */
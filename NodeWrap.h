@@ -43,13 +43,15 @@ public:
         realTreeNode = nT;
     }
     
-    virtual ~NodeWrap()
+    ~NodeWrap()
     {
         
     }
     
     /// Overloading operator[] and operator()
     /// operator[] allows you to say node[LEFT] to refer to node->leftNode
+    /// The links are plain TreeNode pointers; nodeCast gets us back to NodeType
+    /// without any RTTI, and with a constant dir the switch folds away too.
     /// operator() gives you a pointer to the pointer to the node, e.g. node[LEFT] &(node->leftNode)
     /// This will reduce some syntactic clutter when referencing a node a couple of links away
     NodeType *operator[](const TreeNode::NodeDirection dir)
@@ -57,15 +59,15 @@ public:
         switch (dir)
         {
             case RIGHT:
-                return dynamic_cast<NodeType *>(realTreeNode->rightNode);
+                return nodeCast<NodeType>(realTreeNode->rightNode);
                 break;
                 
             case LEFT:
-                return dynamic_cast<NodeType *>(realTreeNode->leftNode);
+                return nodeCast<NodeType>(realTreeNode->leftNode);
                 break;
                 
             case PARENT:
-                return dynamic_cast<NodeType *>(realTreeNode->parentNode);
+                return nodeCast<NodeType>(realTreeNode->parentNode);
                 break;
                 
             case NONE:
@@ -85,15 +87,15 @@ public:
         switch (dir)
         {
             case RIGHT:
-                return dynamic_cast<NodeType *>(realTreeNode->rightNode);
+                return nodeCast<NodeType>(realTreeNode->rightNode);
                 break;
                 
             case LEFT:
-                return dynamic_cast<NodeType *>(realTreeNode->leftNode);
+                return nodeCast<NodeType>(realTreeNode->leftNode);
                 break;
                 
             case PARENT:
-                return dynamic_cast<NodeType *>(realTreeNode->parentNode);
+                return nodeCast<NodeType>(realTreeNode->parentNode);
                 break;
                 
             case NONE:
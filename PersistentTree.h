@@ -0,0 +1,665 @@
+//
+//  PersistentTree.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__PersistentTree__
+#define __Tree_exercises__PersistentTree__
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <assert.h>
+
+#include "TreeMap.h"
+
+template <typename KeyT, typename ValueT, typename CompareT>
+class PersistentTreeVersion;
+template <typename KeyT, typename ValueT, typename CompareT>
+class PersistentTreeMap;
+
+/// A node of a PersistentTreeMap.  It can be part of any number of versions at
+/// once, so it has no parent link (it could have several parents); instead it
+/// counts the references to it, one from each version it's the root of and one
+/// from each node it's a child of.  Once a node is shared it never changes.
+template <typename KeyT, typename ValueT>
+class PersistentTreeNode
+{
+public:
+    const KeyT &getKey() const
+    {
+        return key;
+    }
+    
+    const ValueT &getMapped() const
+    {
+        return value;
+    }
+
+private:
+    template <typename, typename, typename> friend class PersistentTreeVersion;
+    template <typename, typename, typename> friend class PersistentTreeMap;
+    
+    PersistentTreeNode(const KeyT &theKey, const ValueT &theValue) :
+    refs(1), height(1), left(nullptr), right(nullptr), key(theKey), value(theValue)
+    {
+        
+    }
+    
+    /// A private copy of a shared node, for a version that's about to change it.
+    /// The children are shared between the two now.
+    PersistentTreeNode(const PersistentTreeNode &original) :
+    refs(1), height(original.height), left(retain(original.left)), right(retain(original.right)),
+    key(original.key), value(original.value)
+    {
+        
+    }
+    
+    PersistentTreeNode &operator=(const PersistentTreeNode &) = delete;
+    
+    static PersistentTreeNode *retain(PersistentTreeNode *node)
+    {
+        if (node != nullptr)
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+    
+    /// Drop a reference, and free the node if it was the last one, along with
+    /// whatever only it was holding on to.  Whoever had a node last frees it,
+    /// whichever thread that is.
+    static void release(PersistentTreeNode *node)
+    {
+        // Recurse on the left, loop on the right, so it only goes as deep as the tree
+        while (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            PersistentTreeNode *right = node->right;
+            
+            release(node->left);
+            delete node;
+            node = right;
+        }
+    }
+    
+    std::atomic<unsigned int> refs;
+    unsigned int height;        // AVL, a leaf is 1
+    PersistentTreeNode *left;
+    PersistentTreeNode *right;
+    KeyT key;
+    ValueT value;
+};
+
+/**
+ One version of a PersistentTreeMap, read only.  This is what snapshot() gives
+ you, and the base of the map itself.
+ 
+ Copying a version is O(1): it's one more reference to the same root.  A version
+ keeps everything it can see alive, however the map changes afterwards, and lets
+ go when it goes away; nodes that no version can see any more are freed then.
+ A version can be read, copied and dropped from any thread, while the map it came
+ from keeps changing on its own.
+ 
+ Lookups, lower_bound/upper_bound and forward iteration work the same as on the
+ map.  Iterators carry the path down from the root with them, since there are no
+ parent links to climb back up, and are good for as long as the version is.
+ **/
+template <typename KeyT, typename ValueT, typename CompareT = std::less<KeyT> >
+class PersistentTreeVersion
+{
+public:
+    typedef PersistentTreeNode<KeyT, ValueT> Node;
+    typedef KeyT key_type;
+    typedef ValueT mapped_type;
+    typedef size_t size_type;
+    
+    /// No AVL tree that fits in memory gets anywhere near this tall
+    static const unsigned int maxHeight = 96;
+    
+    /// Forward, in-order iterator.  end() has an empty path.
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Node value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Node *pointer;
+        typedef const Node &reference;
+        
+        const_iterator() : depth(0)
+        {
+            
+        }
+        
+        reference operator*() const
+        {
+            return *path[depth - 1];
+        }
+        
+        pointer operator->() const
+        {
+            return path[depth - 1];
+        }
+        
+        const_iterator &operator++()
+        {
+            assert(depth > 0);  // can't go past end()
+            pushLeftSpine(path[--depth]->right);
+            return *this;
+        }
+        
+        const_iterator operator++(int)
+        {
+            const_iterator before(*this);
+            ++(*this);
+            return before;
+        }
+        
+        bool operator==(const const_iterator &rhs) const
+        {
+            if (depth == 0 || rhs.depth == 0)
+                return depth == rhs.depth;
+            return path[depth - 1] == rhs.path[rhs.depth - 1];
+        }
+        
+        bool operator!=(const const_iterator &rhs) const
+        {
+            return !(*this == rhs);
+        }
+    
+    private:
+        friend class PersistentTreeVersion;
+        
+        void pushLeftSpine(const Node *node)
+        {
+            for ( ; node != nullptr ; node = node->left)
+                path[depth++] = node;
+        }
+        
+        // The current node on top, and below it every node whose left subtree we're in
+        const Node *path[maxHeight];
+        unsigned int depth;
+    };
+    
+    typedef const_iterator iterator;
+    
+    PersistentTreeVersion() : root(nullptr), nodeCount(0)
+    {
+        
+    }
+    
+    PersistentTreeVersion(const PersistentTreeVersion &other) : root(Node::retain(other.root)), nodeCount(other.nodeCount)
+    {
+        
+    }
+    
+    PersistentTreeVersion(PersistentTreeVersion &&other) : root(other.root), nodeCount(other.nodeCount)
+    {
+        other.root = nullptr;
+        other.nodeCount = 0;
+    }
+    
+    PersistentTreeVersion &operator=(PersistentTreeVersion other)
+    {
+        std::swap(root, other.root);
+        std::swap(nodeCount, other.nodeCount);
+        return *this;
+    }
+    
+    ~PersistentTreeVersion()
+    {
+        Node::release(root);
+    }
+    
+    size_t size() const
+    {
+        return nodeCount;
+    }
+    
+    bool empty() const
+    {
+        return nodeCount == 0;
+    }
+    
+    unsigned int getHeight() const
+    {
+        return heightOf(root);
+    }
+    
+    const_iterator begin() const
+    {
+        const_iterator it;
+        it.pushLeftSpine(root);
+        return it;
+    }
+    
+    const_iterator end() const
+    {
+        return const_iterator();
+    }
+    
+    const_iterator find(const KeyT &key) const
+    {
+        const_iterator it = lower_bound(key);
+        
+        if (it != end() && KeyOrder<KeyT, CompareT>::compare(it->getKey(), key) == 0)
+            return it;
+        return end();
+    }
+    
+    bool contains(const KeyT &key) const
+    {
+        return findNode(key) != nullptr;
+    }
+    
+    /// The value key maps to, or nullptr
+    const ValueT *get(const KeyT &key) const
+    {
+        const Node *node = findNode(key);
+        
+        return (node != nullptr ? &node->value : nullptr);
+    }
+    
+    /// First entry whose key isn't less than key (lower) or is greater (upper)
+    const_iterator lower_bound(const KeyT &key) const
+    {
+        return boundEntry(key, false);
+    }
+    
+    const_iterator upper_bound(const KeyT &key) const
+    {
+        return boundEntry(key, true);
+    }
+    
+    /// Check the whole version: keys in order, AVL heights right and balanced,
+    /// reference counts sane, and the entry count.  O(n), for debugging and tests.
+    bool verifyTree() const;
+
+protected:
+    static unsigned int heightOf(const Node *node)
+    {
+        return (node != nullptr ? node->height : 0);
+    }
+    
+    const Node *findNode(const KeyT &key) const;
+    const_iterator boundEntry(const KeyT &key, bool upper) const;
+    unsigned int verifyNode(const Node *node, const KeyT *low, const KeyT *high, size_t &entries) const;
+    
+    Node *root;
+    size_t nodeCount;
+};
+
+/**
+ Ordered map with O(1) snapshots, for long reads of a consistent view while the
+ map keeps changing.
+ 
+ It's an AVL tree of reference counted nodes.  A change copies the nodes on its way
+ down that some other version (a snapshot, or a copy of the map) can also see, and
+ changes its own copies; everything off that path stays shared.  So a change costs
+ O(log n) new nodes at worst, the old version is left just as it was, and
+ snapshot() only has to take a reference to the root.  Nodes only this map can
+ see are changed in place, so with no snapshots around it's an ordinary AVL tree:
+ a node with one reference, reached through nodes this map owns, can only be
+ reachable from this map.
+ 
+ BinaryTree can't do this itself: its nodes link to their parents, and its
+ iterators, erase and balance policies all climb those links, but a shared node
+ can have any number of parents.
+ 
+ The API follows the other maps as far as it can: try_emplace and insert_or_assign
+ (returning whether the key was new), erase, find, contains, get,
+ lower_bound/upper_bound and forward iterators giving getKey() and getMapped().
+ Values can only be changed through insert_or_assign, since any other version
+ might be looking at them.  Copying the map is as cheap as a snapshot.  KeyT and
+ ValueT have to be copyable; nodes are allocated one by one, since they can be
+ freed from whichever thread drops the last version holding them.
+ **/
+template <typename KeyT, typename ValueT, typename CompareT = std::less<KeyT> >
+class PersistentTreeMap : public PersistentTreeVersion<KeyT, ValueT, CompareT>
+{
+    typedef PersistentTreeVersion<KeyT, ValueT, CompareT> Version;
+    typedef typename Version::Node Node;
+
+public:
+    typedef Version Snapshot;
+    
+    PersistentTreeMap()
+    {
+        
+    }
+    
+    /// Carry on from an older version, e.g. to roll back to a snapshot
+    explicit PersistentTreeMap(const Snapshot &version) : Version(version)
+    {
+        
+    }
+    
+    /// The map as it is now, for as long as you keep it.  O(1).
+    Snapshot snapshot() const
+    {
+        return Snapshot(*this);
+    }
+    
+    /// Add key with value, unless key is already there.  Returns whether it's new.
+    bool try_emplace(const KeyT &key, const ValueT &value = ValueT())
+    {
+        // Don't copy a path for nothing
+        if (this->contains(key))
+            return false;
+        
+        return insert_or_assign(key, value);
+    }
+    
+    /// Add key with value, or give key value if it's already there.  Returns
+    /// whether it's new.
+    bool insert_or_assign(const KeyT &key, const ValueT &value)
+    {
+        bool added = false;
+        
+        root = insertAt(root, key, value, added);
+        return added;
+    }
+    
+    /// Remove key if it's there.  Returns the number of entries removed (0 or 1).
+    size_t erase(const KeyT &key)
+    {
+        if (!this->contains(key))
+            return 0;
+        
+        root = eraseAt(root, key);
+        nodeCount--;
+        return 1;
+    }
+    
+    void clear()
+    {
+        Node::release(root);
+        root = nullptr;
+        nodeCount = 0;
+    }
+
+private:
+    using Version::root;
+    using Version::nodeCount;
+    using Version::heightOf;
+    
+    Node *own(Node *node);
+    Node *insertAt(Node *node, const KeyT &key, const ValueT &value, bool &added);
+    Node *eraseAt(Node *node, const KeyT &key);
+    Node *removeMin(Node *node, KeyT &key, ValueT &value);
+    Node *rebalance(Node *node);
+    Node *rotateLeft(Node *node);
+    Node *rotateRight(Node *node);
+    
+    static void updateHeight(Node *node)
+    {
+        unsigned int leftHeight = heightOf(node->left);
+        unsigned int rightHeight = heightOf(node->right);
+        
+        node->height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+    }
+};
+
+
+
+template <typename KeyT, typename ValueT, typename CompareT>
+const typename PersistentTreeVersion<KeyT, ValueT, CompareT>::Node *
+PersistentTreeVersion<KeyT, ValueT, CompareT>::findNode(const KeyT &key) const
+{
+    const Node *node = root;
+    
+    while (node != nullptr)
+    {
+        int compResult = KeyOrder<KeyT, CompareT>::compare(key, node->key);
+        
+        if (compResult == 0)
+            return node;
+        
+        node = (compResult < 0 ? node->left : node->right);
+    }
+    
+    return nullptr;
+}
+
+// Every node we go left at is one we'll come back to, the last of them the bound
+template <typename KeyT, typename ValueT, typename CompareT>
+typename PersistentTreeVersion<KeyT, ValueT, CompareT>::const_iterator
+PersistentTreeVersion<KeyT, ValueT, CompareT>::boundEntry(const KeyT &key, bool upper) const
+{
+    const_iterator it;
+    const Node *node = root;
+    
+    while (node != nullptr)
+    {
+        int compResult = KeyOrder<KeyT, CompareT>::compare(node->key, key);
+        
+        if (compResult < 0 || (upper && compResult == 0))
+        {
+            node = node->right;
+        }
+        else
+        {
+            it.path[it.depth++] = node;
+            node = node->left;
+        }
+    }
+    
+    return it;
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+bool PersistentTreeVersion<KeyT, ValueT, CompareT>::verifyTree() const
+{
+    size_t entries = 0;
+    
+    if (root != nullptr && verifyNode(root, nullptr, nullptr, entries) == 0)
+        return false;
+    
+    if (entries != nodeCount)
+    {
+        std::cerr << "Persistent tree has " << entries << " entries, thinks it has " << nodeCount << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+// Returns the subtree's height, or 0 if anything's wrong.  Keys have to be in (low, high).
+template <typename KeyT, typename ValueT, typename CompareT>
+unsigned int PersistentTreeVersion<KeyT, ValueT, CompareT>::verifyNode(const Node *node, const KeyT *low, const KeyT *high,
+                                                                       size_t &entries) const
+{
+    if (node == nullptr)
+        return 1;
+    
+    if ((low != nullptr && KeyOrder<KeyT, CompareT>::compare(*low, node->key) >= 0) ||
+        (high != nullptr && KeyOrder<KeyT, CompareT>::compare(node->key, *high) >= 0))
+    {
+        std::cerr << "Persistent tree out of order at node " << (const void *)node << std::endl;
+        return 0;
+    }
+    
+    if (node->refs.load(std::memory_order_relaxed) == 0)
+    {
+        std::cerr << "Freed node " << (const void *)node << " still in the tree" << std::endl;
+        return 0;
+    }
+    
+    unsigned int leftHeight = verifyNode(node->left, low, &node->key, entries);
+    unsigned int rightHeight = verifyNode(node->right, &node->key, high, entries);
+    
+    if (leftHeight == 0 || rightHeight == 0)
+        return 0;
+    
+    // Both are one more than the real height here (an empty subtree is 1)
+    if (node->height != (leftHeight > rightHeight ? leftHeight : rightHeight) ||
+        leftHeight > rightHeight + 1 || rightHeight > leftHeight + 1)
+    {
+        std::cerr << "Persistent tree out of balance at node " << (const void *)node << std::endl;
+        return 0;
+    }
+    
+    entries++;
+    return node->height + 1;
+}
+
+// Get a node this map can change: the node itself if nothing else can see it,
+// otherwise a copy that takes over this map's reference.  The caller has to own
+// the node's parent (or be the root's map), which is what makes one reference
+// enough to go on.
+template <typename KeyT, typename ValueT, typename CompareT>
+typename PersistentTreeMap<KeyT, ValueT, CompareT>::Node *PersistentTreeMap<KeyT, ValueT, CompareT>::own(Node *node)
+{
+    // Acquire, so whatever a version that's let go of it did with it is over with
+    if (node->refs.load(std::memory_order_acquire) == 1)
+        return node;
+    
+    Node *copy = new Node(*node);
+    Node::release(node);
+    return copy;
+}
+
+// Each of these takes over the reference its caller had to node, and hands back
+// one to whatever is at the top of the subtree afterwards
+template <typename KeyT, typename ValueT, typename CompareT>
+typename PersistentTreeMap<KeyT, ValueT, CompareT>::Node *
+PersistentTreeMap<KeyT, ValueT, CompareT>::insertAt(Node *node, const KeyT &key, const ValueT &value, bool &added)
+{
+    if (node == nullptr)
+    {
+        added = true;
+        nodeCount++;
+        return new Node(key, value);
+    }
+    
+    node = own(node);
+    
+    int compResult = KeyOrder<KeyT, CompareT>::compare(key, node->key);
+    
+    if (compResult == 0)
+    {
+        node->value = value;
+        return node;
+    }
+    
+    if (compResult < 0)
+        node->left = insertAt(node->left, key, value, added);
+    else
+        node->right = insertAt(node->right, key, value, added);
+    
+    return (added ? rebalance(node) : node);
+}
+
+// key has to be in the subtree
+template <typename KeyT, typename ValueT, typename CompareT>
+typename PersistentTreeMap<KeyT, ValueT, CompareT>::Node *
+PersistentTreeMap<KeyT, ValueT, CompareT>::eraseAt(Node *node, const KeyT &key)
+{
+    int compResult = KeyOrder<KeyT, CompareT>::compare(key, node->key);
+    
+    if (compResult == 0)
+    {
+        // With a child missing, the other one takes its place
+        if (node->left == nullptr || node->right == nullptr)
+        {
+            Node *child = Node::retain(node->left != nullptr ? node->left : node->right);
+            
+            Node::release(node);
+            return child;
+        }
+        
+        // Otherwise the smallest entry on the right moves up into it
+        node = own(node);
+        node->right = removeMin(node->right, node->key, node->value);
+        return rebalance(node);
+    }
+    
+    node = own(node);
+    
+    if (compResult < 0)
+        node->left = eraseAt(node->left, key);
+    else
+        node->right = eraseAt(node->right, key);
+    
+    return rebalance(node);
+}
+
+// Take the smallest entry out of the subtree, handing back its key and value
+template <typename KeyT, typename ValueT, typename CompareT>
+typename PersistentTreeMap<KeyT, ValueT, CompareT>::Node *
+PersistentTreeMap<KeyT, ValueT, CompareT>::removeMin(Node *node, KeyT &key, ValueT &value)
+{
+    if (node->left == nullptr)
+    {
+        Node *right = Node::retain(node->right);
+        
+        key = node->key;
+        value = node->value;
+        Node::release(node);
+        return right;
+    }
+    
+    node = own(node);
+    node->left = removeMin(node->left, key, value);
+    return rebalance(node);
+}
+
+// node's subtrees are balanced, and their heights at most two apart.  Fix node's
+// height, rotating first if they are two apart (see AVLBalance::rebalanceAt).
+template <typename KeyT, typename ValueT, typename CompareT>
+typename PersistentTreeMap<KeyT, ValueT, CompareT>::Node *PersistentTreeMap<KeyT, ValueT, CompareT>::rebalance(Node *node)
+{
+    unsigned int leftHeight = heightOf(node->left);
+    unsigned int rightHeight = heightOf(node->right);
+    
+    if (leftHeight > rightHeight + 1)
+    {
+        if (heightOf(node->left->right) > heightOf(node->left->left))
+            node->left = rotateLeft(own(node->left));
+        return rotateRight(node);
+    }
+    
+    if (rightHeight > leftHeight + 1)
+    {
+        if (heightOf(node->right->left) > heightOf(node->right->right))
+            node->right = rotateRight(own(node->right));
+        return rotateLeft(node);
+    }
+    
+    updateHeight(node);
+    return node;
+}
+
+// node is this map's, and its child comes up into its place.  Both are changed,
+// so the child has to be this map's too.
+template <typename KeyT, typename ValueT, typename CompareT>
+typename PersistentTreeMap<KeyT, ValueT, CompareT>::Node *PersistentTreeMap<KeyT, ValueT, CompareT>::rotateLeft(Node *node)
+{
+    Node *pivot = own(node->right);
+    
+    node->right = pivot->left;
+    pivot->left = node;
+    
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+template <typename KeyT, typename ValueT, typename CompareT>
+typename PersistentTreeMap<KeyT, ValueT, CompareT>::Node *PersistentTreeMap<KeyT, ValueT, CompareT>::rotateRight(Node *node)
+{
+    Node *pivot = own(node->left);
+    
+    node->left = pivot->right;
+    pivot->right = node;
+    
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+#endif /* defined(__Tree_exercises__PersistentTree__) */
@@ -0,0 +1,382 @@
+//
+//  RedBlackBalance.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__RedBlackBalance__
+#define __Tree_exercises__RedBlackBalance__
+
+#include <iostream>
+#include <assert.h>
+
+#include "TreeNode.h"
+#include "NodeWrap.h"
+#include "BinaryTree.h"
+
+/**
+ BinaryTree's default balance policy: a red-black tree, i.e. a 2-3-4 tree with
+ each 2-3-4 node spread over one black node and up to two red ones.
+ 
+ What a balance policy provides (BinaryTree calls these, and a policy can get at
+ the tree's private rotate, treeRoot and counters):
+ 
+ * linkRoot(tree, node): node is the first one in an empty tree
+ * afterInsert(tree, node): node was just linked in as a leaf.  Returns the number
+   of levels it had to look at.
+ * beforeErase(tree, node) and afterErase(tree, removed, replacement, parent): around
+   taking node out.  removed carries the balancing state of the spot that went away
+   (see BinaryTree::unlinkNode); replacement took its place, under parent.
+ * builtNode(node, depth, lastDepth): node was just linked into a tree built from
+   sorted nodes (see BinaryTree::linkSorted), after its children
+ * fillStats(tree, stats): tighten the generic bounds in stats, see TreeStats
+ * verifyNode(node, leftMeasure, rightMeasure), verifyLocal(node) and
+   verifyState(tree): the policy's part of verifyTree, verifyPath and verifyStats
+ **/
+class RedBlackBalance
+{
+public:
+    RedBlackBalance() : blackHeight(0)
+    {
+        
+    }
+    
+    /// Black nodes on every path from the root down to a null
+    unsigned int getBlackHeight() const
+    {
+        return blackHeight;
+    }
+    
+    template <typename TreeT, typename NodeT>
+    void linkRoot(TreeT &tree, NodeT *root)
+    {
+        root->setToBlack();
+        blackHeight = 1;
+    }
+    
+    /// The new node went in red (see TreeNode::spliceNodeLeft), so the only thing
+    /// that can be wrong is a red node under a red parent
+    template <typename TreeT, typename NodeT>
+    unsigned int afterInsert(TreeT &tree, NodeT *node)
+    {
+        return reBalance(tree, nodeCast<NodeT>(node->parentNode), node->getParentDir());
+    }
+    
+    template <typename TreeT, typename NodeT>
+    void beforeErase(TreeT &tree, NodeT *node)
+    {
+        
+    }
+    
+    /// Taking out a red node can't break anything; taking out a black one leaves
+    /// its replacement one black short, which eraseFixup repairs
+    template <typename TreeT, typename NodeT>
+    void afterErase(TreeT &tree, NodeT *removed, NodeT *replacement, NodeT *parent)
+    {
+        if (removed->isBlack())
+            eraseFixup(tree, replacement, parent);
+    }
+    
+    /// Black, except for the partial last level (if there is one), see BinaryTree::linkSorted
+    template <typename NodeT>
+    void builtNode(NodeT *node, unsigned int depth, unsigned int lastDepth)
+    {
+        if (depth == lastDepth) node->setToRed();
+        else node->setToBlack();
+        
+        // The root comes last: every level above the red one is black
+        if (depth == 0)
+            blackHeight = lastDepth;
+    }
+    
+    template <typename TreeT>
+    void fillStats(const TreeT &tree, TreeStats &stats) const
+    {
+        stats.blackHeight = blackHeight;
+        
+        if (blackHeight > stats.minHeight)
+            stats.minHeight = blackHeight;
+        if (2 * blackHeight < stats.maxHeight)
+            stats.maxHeight = 2 * blackHeight;
+        
+        // A leaf has only nulls below it, so the path to it has all blackHeight black
+        // nodes on it, and no more than that many red ones
+        stats.minLeafDepth = (blackHeight > 0 ? blackHeight - 1 : 0);
+        stats.maxLeafDepth = (stats.maxHeight > 0 ? stats.maxHeight - 1 : 0);
+    }
+    
+    /// Measure is the black height, counting the nulls at the bottom
+    template <typename NodeT>
+    unsigned int verifyNode(const NodeT *node, unsigned int leftMeasure, unsigned int rightMeasure) const
+    {
+        if (!verifyLocal(node))
+            return 0;
+        
+        if (leftMeasure != rightMeasure)
+        {
+            std::cerr << "Black violation at node " << (void *)node << std::endl;
+            return 0;
+        }
+        
+        return node->isRed() ? leftMeasure : leftMeasure + 1;
+    }
+    
+    template <typename NodeT>
+    bool verifyLocal(const NodeT *node) const
+    {
+        if (node->isRed() && (TreeNode::isRed(node->leftNode) || TreeNode::isRed(node->rightNode)))
+        {
+            std::cerr << "Red violation, node " << (void *)node << std::endl;
+            return false;
+        }
+        
+        return true;
+    }
+    
+    /// Black root, and a black height that's up to date
+    template <typename TreeT>
+    bool verifyState(const TreeT &tree) const
+    {
+        unsigned int realBlackHeight = 0;
+        
+        if (tree.treeRoot != nullptr && tree.treeRoot->isRed())
+        {
+            std::cerr << "Red root " << (void *)tree.treeRoot << std::endl;
+            return false;
+        }
+        
+        for (const TreeNode *node = tree.treeRoot ; node != nullptr ; node = node->leftNode)
+        {
+            if (node->isBlack())
+                realBlackHeight++;
+        }
+        
+        if (realBlackHeight != blackHeight)
+        {
+            std::cerr << "Black height " << blackHeight << " should be " << realBlackHeight << std::endl;
+            return false;
+        }
+        
+        return true;
+    }
+
+private:
+    template <typename TreeT, typename NodeT>
+    unsigned int reBalance(TreeT &tree, NodeT *node, TreeNode::NodeDirection whichSide);
+    template <typename TreeT, typename NodeT>
+    NodeT *doRotation(TreeT &tree, NodeT *node, TreeNode::NodeDirection rotateDir);
+    template <typename TreeT, typename NodeT>
+    NodeT *doDoubleRotation(TreeT &tree, NodeT *node, TreeNode::NodeDirection rotateDir);
+    template <typename TreeT, typename NodeT>
+    void eraseFixup(TreeT &tree, NodeT *node, NodeT *parent);
+    
+    unsigned int blackHeight;      // kept up to date by the fixups, see TreeStats
+};
+
+/**
+ Here are the allowed node configurations:
+ 
+ 2-node:         Black
+                /    \
+ 
+ 3-node:        Black                       Black
+                /    \                      /     \
+                Red                                Red
+                /   \                               /  \
+ 
+ 4-node: (must be split!)
+ Black
+ /     \
+ Red     Red
+ /   \   /   \
+ 
+ All other configurations are invalid and need to be repaired
+ 
+ Governing rules are:
+ 
+ * A red node can't have a red node child. red nodes abstract the 2-3-4 tree so their
+ children have to be black nodes
+ * Since the leaves of a 2-3-4 tree are at the same level, the same has to be true of
+ the black nodes in a red-black tree.  Red nodes aren't counted since they're "abstract" in
+ the red-black tree sense, and a black node and its red children are one abstract 2-3-4 node.
+ So... the number of black nodes on any path of a red-black tree must be the same.
+ **/
+/// The argument node is the parent of the node we just added (which is red), on side
+/// whichSide.  We only look locally at a node, its parent and its sibling (the "uncle")
+/// and walk up the tree only as far as we have to:
+///
+/// * parent is black: nothing's wrong, we're done.
+/// * parent and uncle are both red: that's a 4-node, split it by flipping colors
+///   (grandparent goes red, parent and uncle black).  The grandparent may now be a red
+///   node under a red node, so carry on from there.
+/// * parent is red and uncle black: one rotation (or two, if the new node is on the
+///   inside) makes a proper 3-node, and we're done.
+///
+/// So it's a loop, not a walk all the way to the root, and it stops after at most
+/// two rotations.  Returns the number of levels visited.
+template <typename TreeT, typename NodeT>
+unsigned int RedBlackBalance::reBalance(TreeT &tree, NodeT *node, TreeNode::NodeDirection whichSide)
+{
+    unsigned int levels = 0;
+    NodeWrap<NodeT> wNode(node);
+    NodeT *child = wNode[whichSide];  // red, and maybe in violation under node
+    
+    while (node != nullptr)
+    {
+        levels++;
+        
+        // Red child under a black parent is fine
+        if (node->isBlack())
+            break;
+        
+        // node is red, so it can't be the root.  Its parent has to be black.
+        NodeT *grandParent = nodeCast<NodeT>(node->parentNode);
+        TreeNode::NodeDirection nodeSide = node->getParentDir();
+        NodeWrap<NodeT> wGrandParent(grandParent);
+        NodeT *uncle = wGrandParent[!nodeSide];
+        
+        assert(grandParent != nullptr && grandParent->isBlack());
+        
+        if (TreeNode::isRed(uncle))
+        {
+            // Split the 4-node.  The root can't be red!
+            node->setToBlack();
+            uncle->setToBlack();
+            treeCount(tree.counters.colorFlips++);
+            
+            // Splitting a 4-node at the root makes every path one black longer
+            if (tree.isRoot(grandParent))
+            {
+                blackHeight++;
+                break;
+            }
+            
+            grandParent->setToRed();
+            child = grandParent;
+            node = nodeCast<NodeT>(grandParent->parentNode);
+            continue;
+        }
+        
+        // Two reds in a row, with a black uncle.  Rotate the red parent up
+        // (with the red child coming up instead if it's on the inside)
+        if (child->getParentDir() == nodeSide)
+            doRotation(tree, grandParent, !nodeSide);
+        else
+            doDoubleRotation(tree, grandParent, !nodeSide);
+        
+        break;
+    }
+    
+    treeCount(tree.counters.insertFixupLevels += levels);
+    
+    return levels;
+}
+
+// We know that the node[rotateDir] is red and node[rotateDir][rotateDir] is red.
+// The child that comes up goes black, node goes red under it.
+template <typename TreeT, typename NodeT>
+NodeT *RedBlackBalance::doRotation(TreeT &tree, NodeT *node, TreeNode::NodeDirection rotateDir)
+{
+    NodeWrap<NodeT> wNode(node);
+    
+    wNode[!rotateDir]->setToBlack();
+    node->setToRed();
+    
+    return tree.rotate(node, rotateDir);
+}
+
+template <typename TreeT, typename NodeT>
+NodeT *RedBlackBalance::doDoubleRotation(TreeT &tree, NodeT *node, TreeNode::NodeDirection rotateDir)
+{
+    // First, do a single rotation so that red grandchild is on the same side and the red child
+    NodeWrap<NodeT> wNode(node);
+    
+    debugPrintf2("*** Double rotation around %s, to the %s\n", describeNode(node).c_str(), directionString(rotateDir));
+    treeCount(tree.counters.doubleRotations++);
+    doRotation(tree, wNode[!rotateDir], !rotateDir);
+    return doRotation(tree, node, rotateDir);
+}
+
+/**
+ The subtree rooted at node (which may be null) is one black node short
+ compared to its sibling.  In 2-3-4 terms we've removed a key from a 2-node,
+ so we either borrow from a sibling (rotations) or merge with it (color flip)
+ and push the problem up a level.
+ 
+ case 1: sibling is red. Rotate so the sibling is black, then carry on below.
+ case 2: sibling is black with two black children.  Make the sibling red (merge),
+         and the parent is now the short subtree.
+ case 3: sibling is black, its far child is black and near child red.  Rotate
+         the sibling so the red child is on the far side.
+ case 4: sibling is black with a red far child.  Rotate around the parent, and
+         recolor, which restores the missing black.  Done.
+ **/
+template <typename TreeT, typename NodeT>
+void RedBlackBalance::eraseFixup(TreeT &tree, NodeT *node, NodeT *parent)
+{
+    bool restored = false;  // did we make up the missing black below the root?
+    
+    while (node != tree.treeRoot && !TreeNode::isRed(node))
+    {
+        treeCount(tree.counters.eraseFixupLevels++);
+        
+        NodeWrap<NodeT> wParent(parent);
+        TreeNode::NodeDirection dir = (wParent[LEFT] == node ? LEFT : RIGHT);
+        NodeT *sibling = wParent[!dir];
+        
+        // A black node was removed from this side, so the other side must have
+        // a black height of at least one
+        assert(sibling != nullptr);
+        
+        if (sibling->isRed())  // case 1
+        {
+            // doRotation leaves the sibling black and the parent red, as we want
+            doRotation(tree, parent, dir);
+            sibling = wParent[!dir];
+        }
+        
+        NodeWrap<NodeT> wSibling(sibling);
+        
+        if (!TreeNode::isRed(wSibling[LEFT]) && !TreeNode::isRed(wSibling[RIGHT]))  // case 2
+        {
+            sibling->setToRed();
+            node = parent;
+            parent = nodeCast<NodeT>(node->parentNode);
+            continue;
+        }
+        
+        if (!TreeNode::isRed(wSibling[!dir]))  // case 3
+        {
+            // Red near child comes up black, the sibling goes red
+            doRotation(tree, sibling, !dir);
+            sibling = wParent[!dir];
+        }
+        
+        // case 4
+        bool parentWasRed = parent->isRed();
+        
+        doRotation(tree, parent, dir);
+        
+        if (parentWasRed) sibling->setToRed();
+        else sibling->setToBlack();
+        parent->setToBlack();
+        
+        NodeWrap<NodeT> wNewTop(sibling);
+        wNewTop[!dir]->setToBlack();
+        
+        restored = true;
+        node = tree.treeRoot;
+    }
+    
+    // Merged all the way up to the root (or emptied the tree): every path is now one
+    // black shorter.  Stopping at a red node, we turn it black to make up the difference.
+    if (!restored && node == tree.treeRoot && !TreeNode::isRed(node))
+        blackHeight--;
+    
+    if (node != nullptr)
+        node->setToBlack();
+}
+
+#endif /* defined(__Tree_exercises__RedBlackBalance__) */
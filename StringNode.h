@@ -10,67 +10,209 @@
 #define __Tree_exercises__StringNode__
 #include <iostream>
 #include <memory>
+#include <string_view>
+#include <cstring>
 #include <assert.h>
 
 #include "TreeNode.h"
+#include "NodeArena.h"
+#include "CaseFold.h"
 
 using namespace std;
 
+/// Node holding a string key.  The key bytes either live in a heap string the
+/// node owns (the plain constructors), or in a NodeArena (the constructors taking
+/// an arena), in which case the node owns no heap memory at all and can be thrown
+/// away along with the arena without running its destructor.
+///
+/// Keys compare ignoring case.  To keep that cheap, the folded (lower case) key is
+/// worked out once when the node is built, and its first 8 bytes are packed
+/// big-endian into abbrevKey, right in the node.  Comparing two abbreviated keys
+/// as integers gives the same answer as comparing those bytes, so most comparisons
+/// never touch the key bytes at all; only ties on the first 8 bytes go on to the
+/// rest of the folded key.
 class StringNode :  public TreeNode
 {
 public:
+    /// A lookup key, abbreviated once up front so a search down the tree only
+    /// does integer compares until it hits a tie.  BinaryTree builds one of these
+    /// from whatever key it's handed (const char *, string_view, string).
+    struct Probe
+    {
+        Probe(const char *key, size_t length) :
+        abbrevKey(foldedPrefix(key, length)),
+        keyData(key),
+        keyLength(length)
+        {
+            
+        }
+        
+        Probe(string_view key) : Probe(key.data(), key.length())
+        {
+            
+        }
+        
+        Probe(const char *key) : Probe(key, strlen(key))
+        {
+            
+        }
+        
+        Probe(const string &key) : Probe(key.data(), key.length())
+        {
+            
+        }
+        
+        uint64_t abbrevKey;
+        const char *keyData;     // not folded
+        size_t keyLength;
+    };
+    
     StringNode()
     {
-        nodeValue = new string("");
+        setOwnedValue(new string(""));
     }
     
     StringNode(string &val)
     {
-        nodeValue = new string(val);
+        setOwnedValue(new string(val));
     }
     
     StringNode(const char *value)
     {
-        nodeValue = new string(value);
+        setOwnedValue(new string(value));
     }
     
     StringNode(StringNode *oldNode) : TreeNode(oldNode)
     {
-        nodeValue = new string(oldNode->getCValue());
+        setOwnedValue(new string(oldNode->keyData, oldNode->keyLength));
     }
     
     StringNode(const StringNode &oldNode) : TreeNode(oldNode)
     {
-        nodeValue = new string(oldNode.getCValue());
+        setOwnedValue(new string(oldNode.keyData, oldNode.keyLength));
     }
     
+    /// Arena constructors: the key (and its folded copy, if it has any upper case)
+    /// is copied into the arena, right next to the node if the node came from the
+    /// same arena
+    StringNode(NodeArena &arena, const char *value, size_t length) : nodeValue(nullptr)
+    {
+        keyData = arena.copyString(value, length);
+        keyLength = length;
+        
+        if (needsFolding(keyData, keyLength))
+        {
+            char *folded = (char *)arena.allocateBytes(keyLength + 1);
+            foldCopy(folded, keyData, keyLength + 1);
+            foldedData = folded;
+        }
+        else
+        {
+            foldedData = keyData;
+        }
+        
+        abbrevKey = foldedPrefix(foldedData, keyLength);
+    }
     
-    virtual ~StringNode()
+    StringNode(NodeArena &arena, const char *value) : StringNode(arena, value, strlen(value))
     {
         
     }
-
-    int compare(const StringNode &rhs) const
+    
+    StringNode(NodeArena &arena, string_view value) : StringNode(arena, value.data(), value.length())
+    {
+        
+    }
+    
+    StringNode(NodeArena &arena, const string &value) : StringNode(arena, value.data(), value.length())
+    {
+        
+    }
+    
+    ~StringNode()
+    {
+        releaseOwnedValue();
+    }
+    
+    /// Arena built StringNodes hold no heap memory, so a tree can drop them in
+    /// bulk without running their destructors
+    static const bool trivialArenaTeardown = true;
+    
+    /// Give an arena node's key, and its folded copy, back to the arena when the
+    /// node is erased, for the next keys to reuse
+    void releaseArenaBytes(NodeArena &arena)
     {
-        string rightHandSide = tolower(*rhs.nodeValue);
-        string leftHandSide = tolower(*nodeValue);
+        if (nodeValue != nullptr)
+            return;
         
-        return rightHandSide.compare(leftHandSide);
+        if (foldedData != keyData)
+            arena.releaseString(foldedData, keyLength);
+        arena.releaseString(keyData, keyLength);
     }
     
+    int compare(const StringNode &rhs) const
+    {
+        return compare(&rhs);
+    }
+    
+    /// Negative if rhs sorts before this node, positive if after
     int compare(const StringNode *rhs) const
     {
-        string rightHandSide = tolower(*rhs->nodeValue);
-        string leftHandSide = tolower(*nodeValue);
+        if (rhs->abbrevKey != abbrevKey)
+            return (rhs->abbrevKey < abbrevKey ? -1 : 1);
         
-        return rightHandSide.compare(leftHandSide);
+        return compareTails(rhs->foldedData, rhs->keyLength, foldedData, keyLength);
     }
     
+    /// Compare a bare key against this node, with no probe node (or string) built.
+    /// Same sign convention as compare():  negative if the key sorts before this node,
+    /// positive if it sorts after, zero if they match (ignoring case)
+    int compareKey(const Probe &key) const
+    {
+        if (key.abbrevKey != abbrevKey)
+            return (key.abbrevKey < abbrevKey ? -1 : 1);
+        
+        // The abbreviated keys tie, so the first 8 bytes (or all of the shorter key)
+        // match already.  Compare the rest; the probe isn't folded so fold as we go.
+        size_t skip = prefixBytes(key.keyLength, keyLength);
+        
+        return foldCompare(key.keyData + skip, key.keyLength - skip, keyData + skip, keyLength - skip);
+    }
+    
+    int compareKey(const char *key, size_t length) const
+    {
+        return compareKey(Probe(key, length));
+    }
+    
+    int compareKey(string_view key) const
+    {
+        return compareKey(key.data(), key.length());
+    }
+    
+    int compareKey(const char *key) const
+    {
+        return compareKey(key, strlen(key));
+    }
+    
+    int compareKey(const string &key) const
+    {
+        return compareKey(key.data(), key.length());
+    }
+    
+    /// Case insensitive three way comparison of two byte ranges, see CaseFold.h
+    static int foldCompare(const char *lhs, size_t lhsLength, const char *rhs, size_t rhsLength)
+    {
+        return ::foldCompare(lhs, lhsLength, rhs, rhsLength);
+    }
+    
+    /// Give the node a new heap string as its key.  The node takes ownership of it
     void setValue(string *value)
     {
-        nodeValue = value;
+        releaseOwnedValue();
+        setOwnedValue(value);
     }
     
+    /// The owned heap string, or nullptr for arena nodes
     string *getValue()
     {
         return nodeValue;
@@ -78,26 +220,83 @@ public:
     
     const char *getCValue() const
     {
-        return nodeValue->c_str();
+        return keyData;
     }
     
-    static string tolower(string &str)
+    size_t getLength() const
     {
-        string result(str);
-        
-        const char *cstr = result.c_str();
+        return keyLength;
+    }
+    
+    /// The first 8 bytes of the folded key, big-endian, zero padded
+    uint64_t getAbbrevKey() const
+    {
+        return abbrevKey;
+    }
+    
+private:
+    void setOwnedValue(string *value)
+    {
+        nodeValue = value;
+        keyData = value->c_str();
+        keyLength = value->length();
         
-        for (int i = 0 ; cstr[i] != '\0' ; i++)
+        if (needsFolding(keyData, keyLength))
+        {
+            char *folded = new char[keyLength + 1];
+            foldCopy(folded, keyData, keyLength + 1);
+            foldedData = folded;
+        }
+        else
         {
-            if (cstr[i] >= 'A' and cstr[i] <= 'Z')
-                result[i] = cstr[i] + 32;
+            foldedData = keyData;
         }
         
-        return result;
+        abbrevKey = foldedPrefix(foldedData, keyLength);
     }
     
-private:
-        string *nodeValue;
+    // Heap nodes own their key string and, if the key had upper case in it, the
+    // folded copy.  Arena nodes own nothing.
+    void releaseOwnedValue()
+    {
+        if (nodeValue != nullptr && foldedData != keyData)
+            delete [] foldedData;
+        
+        delete nodeValue;
+        nodeValue = nullptr;
+    }
+    
+    /// How many leading bytes an abbreviated key tie vouches for
+    static size_t prefixBytes(size_t lhsLength, size_t rhsLength)
+    {
+        size_t common = (lhsLength < rhsLength ? lhsLength : rhsLength);
+        
+        return (common < sizeof(uint64_t) ? common : sizeof(uint64_t));
+    }
+    
+    /// Finish comparing two folded keys whose abbreviated keys tie
+    static int compareTails(const char *lhs, size_t lhsLength, const char *rhs, size_t rhsLength)
+    {
+        size_t skip = prefixBytes(lhsLength, rhsLength);
+        size_t common = (lhsLength < rhsLength ? lhsLength : rhsLength);
+        int result = memcmp(lhs + skip, rhs + skip, common - skip);
+        
+        if (result != 0)
+            return result;
+        
+        if (lhsLength == rhsLength)
+            return 0;
+        
+        return (lhsLength < rhsLength ? -1 : 1);
+    }
+    
+    StringNode &operator=(const StringNode &) = delete;
+    
+    uint64_t abbrevKey;     // first 8 bytes of foldedData, see above
+    const char *keyData;    // NUL terminated key, in nodeValue or an arena
+    const char *foldedData; // keyData folded to lower case; just keyData if it had no upper case
+    size_t keyLength;
+    string *nodeValue;      // owned heap copy of the key, nullptr for arena nodes
 };
 
 #endif /* defined(__Tree_exercises__StringNode__) */
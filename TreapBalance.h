@@ -0,0 +1,155 @@
+//
+//  TreapBalance.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__TreapBalance__
+#define __Tree_exercises__TreapBalance__
+
+#include <cstdint>
+#include <iostream>
+
+#include "TreeNode.h"
+#include "BinaryTree.h"
+
+/**
+ Treap balance policy for BinaryTree, e.g. BinaryTree<StringNode, TreapBalance>.
+ 
+ Every node gets a random priority (in balanceInfo), and the tree is kept a heap on
+ them: no node has a higher priority than its parent.  The shape is then the one
+ inserting the keys in priority order would give, i.e. a random binary search tree,
+ about 3 log2(n) levels deep on average whatever order the keys really came in.
+ 
+ Writes are cheap and stay local: an insert rotates the new node up only while its
+ parent has a lower priority (fewer than two rotations on average), and an erase
+ rotates the node down to where it has at most one child.  Nothing above the
+ changed spot is ever touched, and there's no color or height upkeep.  The price is
+ that the balance is only expected, not guaranteed.
+ 
+ Priorities come from a generator seeded the same way in every tree, so runs are
+ repeatable; use getBalancePolicy().seed() for a different sequence.  See
+ RedBlackBalance.h for what a balance policy provides.
+ **/
+class TreapBalance
+{
+public:
+    TreapBalance() : state(0x853c49e6748fea9bULL)
+    {
+        
+    }
+    
+    void seed(uint64_t newSeed)
+    {
+        state = newSeed;
+    }
+    
+    template <typename TreeT, typename NodeT>
+    void linkRoot(TreeT &tree, NodeT *root)
+    {
+        root->balanceInfo = nextPriority();
+    }
+    
+    /// Rotate the new node up past every ancestor with a lower priority
+    template <typename TreeT, typename NodeT>
+    unsigned int afterInsert(TreeT &tree, NodeT *node)
+    {
+        unsigned int levels = 1;
+        
+        node->balanceInfo = nextPriority();
+        
+        while (node->parentNode != nullptr && node->parentNode->balanceInfo < node->balanceInfo)
+        {
+            NodeT *parent = nodeCast<NodeT>(node->parentNode);
+            
+            tree.rotate(parent, node->getParentDir() == LEFT ? RIGHT : LEFT);
+            levels++;
+        }
+        
+        treeCount(tree.counters.insertFixupLevels += levels);
+        
+        return levels;
+    }
+    
+    /// Rotate the node down, its higher priority child coming up each time, until
+    /// it has at most one child and can just be spliced out
+    template <typename TreeT, typename NodeT>
+    void beforeErase(TreeT &tree, NodeT *node)
+    {
+        while (node->leftNode != nullptr && node->rightNode != nullptr)
+        {
+            bool leftUp = node->leftNode->balanceInfo > node->rightNode->balanceInfo;
+            
+            tree.rotate(node, leftUp ? RIGHT : LEFT);
+            treeCount(tree.counters.eraseFixupLevels++);
+        }
+    }
+    
+    template <typename TreeT, typename NodeT>
+    void afterErase(TreeT &tree, NodeT *removed, NodeT *replacement, NodeT *parent)
+    {
+        
+    }
+    
+    /// A sorted build comes out perfectly balanced, not random.  Give each level
+    /// its own band of priorities, the root's the highest, so it's a valid heap,
+    /// with random ones inside the bands so later inserts land at about the level
+    /// they would have in a random tree.
+    template <typename NodeT>
+    void builtNode(NodeT *node, unsigned int depth, unsigned int lastDepth)
+    {
+        uint64_t bandWidth = ((uint64_t)1 << 32) / (lastDepth + 1);
+        
+        node->balanceInfo = (unsigned int)((lastDepth - depth) * bandWidth + nextPriority() % bandWidth);
+    }
+    
+    /// No better than the generic bounds
+    template <typename TreeT>
+    void fillStats(const TreeT &tree, TreeStats &stats) const
+    {
+        
+    }
+    
+    /// Nothing to measure; the heap order is checked node by node
+    template <typename NodeT>
+    unsigned int verifyNode(const NodeT *node, unsigned int leftMeasure, unsigned int rightMeasure) const
+    {
+        return verifyLocal(node) ? 1 : 0;
+    }
+    
+    template <typename NodeT>
+    bool verifyLocal(const NodeT *node) const
+    {
+        if ((node->leftNode != nullptr && node->leftNode->balanceInfo > node->balanceInfo) ||
+            (node->rightNode != nullptr && node->rightNode->balanceInfo > node->balanceInfo))
+        {
+            std::cerr << "Heap violation, node " << (void *)node << std::endl;
+            return false;
+        }
+        
+        return true;
+    }
+    
+    template <typename TreeT>
+    bool verifyState(const TreeT &tree) const
+    {
+        return true;
+    }
+
+private:
+    /// splitmix64, top half
+    unsigned int nextPriority()
+    {
+        uint64_t x = (state += 0x9e3779b97f4a7c15ULL);
+        
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return (unsigned int)((x ^ (x >> 31)) >> 32);
+    }
+    
+    uint64_t state;
+};
+
+#endif /* defined(__Tree_exercises__TreapBalance__) */
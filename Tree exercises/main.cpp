@@ -7,37 +7,24 @@
 //
 
 #include <iostream>
-#include <fstream>
 #include <ctime>
 #include <assert.h>
 #include <random>
-#include <sys/stat.h>
 
 #include "TreeNode.h"
 #include "BinaryTree.h"
 #include "StringNode.h"
+#include "MappedFile.h"
+#include "LineIndex.h"
 #include "common.h"
 #include "visualizer.h"
 
-#define MAX_WORD_LENGTH   100
 #define DICTIONARY_FILENAME "/usr/share/dict/web2"
 #define WORD_MAX  500 // maximum number of words
 // #define ARRAY_DATA 1
 // #define SORTED_LIST 1
 #define RANDOM_LIST 1
 
-uniform_int_distribution<unsigned> *
-createUniformDist(unsigned min, off_t max)
-{
-    return new uniform_int_distribution<unsigned>(min, max);
-}
-
-default_random_engine *
-createRandomEngine()
-{
-    return new default_random_engine((unsigned int)time(0));
-}
-
 template class BinaryTree<StringNode>;
 int main(int argc, const char * argv[])
 {
@@ -58,129 +45,83 @@ int main(int argc, const char * argv[])
     {
         /// Wrap our nodes in a node wrapper, which allows accessing left and right sub nodes
         /// using [] notation, e.g. wNode[RIGHT]
-        StringNode *theStringNode = new StringNode(str);
+        StringNode *theStringNode = myTree->createNode(str);
         myTree->addNode(theStringNode);
         wordcount++;
     }
 #elif defined(SORTED_LIST)
-    // Let's use some LIVE data
-    std::ifstream instream(DICTIONARY_FILENAME, std::ifstream::in);
-
-    
-    while (!instream.eof() && wordcount < WORD_MAX)  // put a cap on it for now
+    // Let's use some LIVE data.  Map the dictionary rather than reading it, so each
+    // word goes straight from the file into its node in the tree's arena.
+    MappedFile dictionary;
+    if (!dictionary.open(DICTIONARY_FILENAME))
     {
-        char inputbuffer[MAX_WORD_LENGTH];
-        instream.getline(inputbuffer, MAX_WORD_LENGTH);
-        
-        StringNode *theStringNode = new StringNode(inputbuffer);
-        myTree->addNode(theStringNode);
-        wordcount++;
-        
-        if (wordcount % 500 == 0)
-        {
-            cout << "Wordcount is " << wordcount << " at word " << inputbuffer << endl;
-        }
+        cerr << "Can't open dictionary file" << endl;
+        exit(2);
     }
     
-    instream.close();
-#elif defined(RANDOM_LIST)
+    vector<string_view> wordList = dictionary.lines();
+    if (wordList.size() > WORD_MAX)  // put a cap on it for now
+        wordList.resize(WORD_MAX);
+    wordcount = (unsigned int)wordList.size();
     
-    // Use a random list of words from the dictionary
-    // Rather than try to read in all 235,886 words, we seek to a random
-    // position in the file
-    // get file size in bytes
-    struct stat buf;
-    if (stat(DICTIONARY_FILENAME, &buf) < 0)
-    {
-        cerr << "Can't stat dictionary file" << endl;
-        exit(1);
-    }
+    // The dictionary is (nearly) sorted already, so build the tree in one pass
+    // rather than adding a word at a time.  Not quite sorted the way the tree
+    // sorts (it ignores case), so let the tree check and sort if need be.
+    myTree->buildFromUnsorted(wordList.begin(), wordList.end());
+#elif defined(RANDOM_LIST)
     
-    ifstream dictStream(DICTIONARY_FILENAME, fstream::in);
-    if (dictStream.bad())
+    // Use a random list of words from the dictionary.  The line index finds any
+    // word in O(1), and every word is as likely as the next (seeking to a random
+    // byte and backing up to a line break favors long words).  The index is saved
+    // next to the dictionary, so after the first run we don't even scan the file.
+    MappedFile dictionary;
+    if (!dictionary.open(DICTIONARY_FILENAME))
     {
         cerr << "Can't open dictionary file" << endl;
-        exit (2);
+        exit(2);
     }
     
-    uniform_int_distribution<unsigned> *u = createUniformDist(0, buf.st_size);
-    default_random_engine *e = createRandomEngine();
-    
-    /// Vector will be filled with the words from the dictionary
-    vector<string> wordList;
+    LineIndex dictionaryIndex;
+    dictionaryIndex.openFor(DICTIONARY_FILENAME, dictionary);
     
-    for (int i = 0 ; i < WORD_MAX ; i++)
-    {
-        bool done = false;
-        
-        // use this do loop to make sure we do this at least once
-        // and can retry on errors
-        do
-        {
-            unsigned seekLoc = (*u)(*e);
-            dictStream.seekg(seekLoc);
-            
-            assert(dictStream.good());
-            
-            // Tricky part... seek backwards until we get a line break
-            // Forward might be easier, but this way we don't preclude the
-            // first word in the list.
-            while (dictStream.peek() != '\n' && dictStream.good())
-            { 
-                dictStream.seekg(-1, ios_base::cur);
-            }
-            dictStream.seekg(1, ios_base::cur);
-            
-            if (dictStream.bad())  // did we seek back TOO far???
-                continue;
-            
-            char inputbuffer[MAX_WORD_LENGTH];
-            dictStream.getline(inputbuffer, MAX_WORD_LENGTH);
-
-            string theString(inputbuffer);
-            
-            wordList.push_back(theString);
-            
-            done = true;
-            
-        } while (!done);
-    }
+    LineSampler sampler(dictionaryIndex, true, (uint64_t)time(0));
+    string_view word;
     
-    // We should have a nice vector of random words here
-    for (string str : wordList)
+    for (int i = 0 ; i < WORD_MAX && sampler.next(word) ; i++)
     {
-        cerr << str << endl;
-        StringNode *theStringNode = new StringNode(str);
+        cerr << word << endl;
+        StringNode *theStringNode = myTree->createNode(word);
         myTree->addNode(theStringNode);
         wordcount++;
     }
-
-
-    
 #endif
     
     clock_t endTime = clock();
     clock_t elapsedTime = endTime - startTime;
     
-    unsigned int minDepth = (unsigned int)UINTMAX_MAX;
-    unsigned int maxDepth = 0;
-    
     myTree->dumpSortedTree(myTree->getRoot());
-    myTree->getRoot()->fixDepths(0);  // make sure all depths are set correctly
-    myTree->getMinMaxDepth(minDepth, maxDepth);
     
-    printf("\nDone building tree, min depth %d, max depth: %d\n\n", minDepth, maxDepth);
-    printf("Time to find max depth: %f\n", (clock() - endTime) / (double)CLOCKS_PER_SEC);
+    // Shape comes straight from the counts the tree keeps, no need to walk it
+    TreeStats treeStats = myTree->stats();
+    
+    printf("\nDone building tree, %zu nodes, black height %u\n", treeStats.nodeCount, treeStats.blackHeight);
+    printf("Height between %u and %u, leaf depths between %u and %u\n\n",
+           treeStats.minHeight, treeStats.maxHeight, treeStats.minLeafDepth, treeStats.maxLeafDepth);
     printf("\nTotal time: %lu ticks, %f seconds, %d nodes, %f seconds/node\n",
            elapsedTime,
            elapsedTime / (double)CLOCKS_PER_SEC,
            wordcount,
            (elapsedTime / (double)CLOCKS_PER_SEC) / wordcount);
+#ifdef TREE_COUNTERS
+    myTree->getCounters().dump(stdout);
+#endif
     fflush(stdout);
 
     Visualize *vis = new Visualize(myTree->getRoot());
     vis->makeVisualization();
     
+    delete vis;
+    delete myTree;  // nodes all came from the tree's arena, so this is cheap
 }
 
 
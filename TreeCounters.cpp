@@ -0,0 +1,103 @@
+//
+//  TreeCounters.cpp
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#include <cstring>
+
+#include "TreeCounters.h"
+
+const char *treeOperationName(TreeOperation op)
+{
+    switch (op)
+    {
+        case treeOpInsert:
+            return "insert";
+            
+        case treeOpLookup:
+            return "lookup";
+            
+        case treeOpErase:
+            return "erase";
+            
+        default:
+            return "unknown";
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    memset(buckets, 0, sizeof(buckets));
+    samples = 0;
+    totalNanoseconds = 0;
+    maxNanoseconds = 0;
+}
+
+unsigned long long LatencyHistogram::percentile(double fraction) const
+{
+    if (samples == 0)
+        return 0;
+    
+    unsigned long long wanted = (unsigned long long)(fraction * samples);
+    unsigned long long seen = 0;
+    
+    if (wanted < 1)
+        wanted = 1;
+    
+    for (unsigned int i = 0 ; i < bucketCount ; i++)
+    {
+        seen += buckets[i];
+        
+        // Bucket's upper edge, but don't claim more than we actually saw
+        if (seen >= wanted)
+        {
+            unsigned long long upperEdge = 1ULL << (i + 1);
+            
+            return (upperEdge < maxNanoseconds ? upperEdge : maxNanoseconds);
+        }
+    }
+    
+    return maxNanoseconds;
+}
+
+void TreeCounters::reset()
+{
+    memset(operations, 0, sizeof(operations));
+    memset(comparisons, 0, sizeof(comparisons));
+    totalComparisons = 0;
+    rotations = 0;
+    doubleRotations = 0;
+    colorFlips = 0;
+    insertFixupLevels = 0;
+    eraseFixupLevels = 0;
+    
+    for (unsigned int op = 0 ; op < treeOpCount ; op++)
+        latency[op].reset();
+}
+
+void TreeCounters::dump(FILE *out) const
+{
+    for (unsigned int op = 0 ; op < treeOpCount ; op++)
+    {
+        const LatencyHistogram &hist = latency[op];
+        
+        if (operations[op] == 0)
+            continue;
+        
+        fprintf(out, "%-7s %llu ops, %.2f compares/op, mean %.0f ns, p50 %llu ns, p99 %llu ns, p99.9 %llu ns, max %llu ns\n",
+                treeOperationName((TreeOperation)op),
+                operations[op],
+                (double)comparisons[op] / operations[op],
+                hist.meanNanoseconds(),
+                hist.percentile(0.5),
+                hist.percentile(0.99),
+                hist.percentile(0.999),
+                hist.maxNanoseconds);
+    }
+    
+    fprintf(out, "%llu rotations (%llu in double rotations), %llu color flips, fixup levels: %llu insert, %llu erase\n",
+            rotations, 2 * doubleRotations, colorFlips, insertFixupLevels, eraseFixupLevels);
+}
@@ -0,0 +1,152 @@
+//
+//  TreeCounters.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__TreeCounters__
+#define __Tree_exercises__TreeCounters__
+
+#include <cstddef>
+#include <cstdio>
+#include <chrono>
+
+/// Have BinaryTree count what it does on its hot paths (comparisons, rotations,
+/// color flips, fixup levels) and time each operation into a latency histogram.
+/// Unlike DEBUG_OUTPUT this is cheap enough to leave on in production: a few
+/// increments per operation plus two clock reads.  Off by default, in which case
+/// it all compiles away; uncomment here or define it in the build settings.
+// #define TREE_COUNTERS
+
+/// The operations we keep separate counts and latencies for
+enum TreeOperation
+{
+    treeOpInsert,       // addNode
+    treeOpLookup,       // find/contains, lower_bound/upper_bound, rank
+    treeOpErase,        // erase, by key or by node
+    treeOpCount
+};
+
+const char *treeOperationName(TreeOperation op);
+
+/// Latency histogram with power of two buckets: bucket i holds the operations that
+/// took [2^i, 2^(i+1)) nanoseconds (bucket 0 also gets the zeros).  Coarse, but
+/// recording is one bit scan and an increment, and the tail is what we care about.
+struct LatencyHistogram
+{
+    static const unsigned int bucketCount = 40;   // the last one catches anything over ~9 minutes
+    
+    unsigned long long buckets[bucketCount];
+    unsigned long long samples;
+    unsigned long long totalNanoseconds;
+    unsigned long long maxNanoseconds;
+    
+    LatencyHistogram()
+    {
+        reset();
+    }
+    
+    void record(unsigned long long nanoseconds)
+    {
+        unsigned int bucket = (nanoseconds > 1 ? 63 - __builtin_clzll(nanoseconds) : 0);
+        
+        buckets[bucket < bucketCount ? bucket : bucketCount - 1]++;
+        samples++;
+        totalNanoseconds += nanoseconds;
+        if (nanoseconds > maxNanoseconds)
+            maxNanoseconds = nanoseconds;
+    }
+    
+    /// Upper edge of the bucket holding the given fraction of samples, e.g. 0.99 for p99.
+    /// Zero if nothing's been recorded.
+    unsigned long long percentile(double fraction) const;
+    
+    double meanNanoseconds() const
+    {
+        return (samples > 0 ? (double)totalNanoseconds / samples : 0.0);
+    }
+    
+    void reset();
+};
+
+/// Everything a tree counts.  Counts are running totals since the last reset;
+/// divide by operations[] for per operation figures.
+struct TreeCounters
+{
+    unsigned long long operations[treeOpCount];
+    unsigned long long comparisons[treeOpCount];   // key compares made by each kind of operation
+    unsigned long long totalComparisons;            // including ones made outside any of those
+    unsigned long long rotations;                   // every rotation, including both halves of a double
+    unsigned long long doubleRotations;
+    unsigned long long colorFlips;                  // 4-node splits in reBalance (red-black only)
+    unsigned long long insertFixupLevels;           // levels the insert fixup looked at
+    unsigned long long eraseFixupLevels;            // levels the erase fixup moved through
+    LatencyHistogram latency[treeOpCount];
+    
+    TreeCounters()
+    {
+        reset();
+    }
+    
+    void reset();
+    
+    /// Print it all out in a readable form, for logs
+    void dump(FILE *out) const;
+};
+
+#ifdef TREE_COUNTERS
+/// Times one tree operation and charges it the comparisons made while it ran.
+/// Only the outermost operation counts, so erase(key) calling find() is one erase.
+/// The time includes whatever self checking the tree's validation level calls for,
+/// so turn that down (BinaryTree::setValidation) before trusting the latencies.
+class TreeOpTimer
+{
+public:
+    TreeOpTimer(TreeCounters &treeCounters, unsigned int &nesting, TreeOperation op) :
+    counters(treeCounters),
+    depth(nesting),
+    operation(op),
+    outermost(nesting++ == 0),
+    startComparisons(treeCounters.totalComparisons),
+    startTime(std::chrono::steady_clock::now())
+    {
+        
+    }
+    
+    ~TreeOpTimer()
+    {
+        depth--;
+        
+        if (!outermost)
+            return;
+        
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - startTime;
+        
+        counters.operations[operation]++;
+        counters.comparisons[operation] += counters.totalComparisons - startComparisons;
+        counters.latency[operation].record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+private:
+    TreeOpTimer(const TreeOpTimer &) = delete;
+    TreeOpTimer &operator=(const TreeOpTimer &) = delete;
+    
+    TreeCounters &counters;
+    unsigned int &depth;
+    TreeOperation operation;
+    bool outermost;
+    unsigned long long startComparisons;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+/// For use inside BinaryTree, which has the counters and opNesting members these need
+#define treeCount(x) (x)
+#define treeTimeOp(op) TreeOpTimer opTimer(counters, opNesting, op)
+#else
+#define treeCount(x)
+#define treeTimeOp(op)
+#endif
+
+#endif /* defined(__Tree_exercises__TreeCounters__) */
@@ -0,0 +1,624 @@
+//
+//  TreeMap.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__TreeMap__
+#define __Tree_exercises__TreeMap__
+
+#include <array>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "BinaryTree.h"
+
+/// Three-way comparison of two keys under CompareT, a "less than" like std::map's:
+/// negative if lhs sorts first, zero if the two are equivalent, positive if rhs
+/// sorts first.  CompareT has to be default constructible and stateless; one is
+/// made on the spot for each comparison instead of being stored anywhere, so the
+/// compiler sees right through it.
+template <typename KeyT, typename CompareT, typename = void>
+struct KeyOrder
+{
+    static int compare(const KeyT &lhs, const KeyT &rhs)
+    {
+        CompareT less;
+        
+        if (less(lhs, rhs))
+            return -1;
+        return (less(rhs, lhs) ? 1 : 0);
+    }
+};
+
+/// Is CompareT the natural ascending (or descending) order for KeyT?
+template <typename KeyT, typename CompareT>
+struct isAscending : std::integral_constant<bool, std::is_same<CompareT, std::less<KeyT> >::value ||
+                                                  std::is_same<CompareT, std::less<> >::value>
+{
+};
+
+template <typename KeyT, typename CompareT>
+struct isDescending : std::integral_constant<bool, std::is_same<CompareT, std::greater<KeyT> >::value ||
+                                                   std::is_same<CompareT, std::greater<> >::value>
+{
+};
+
+/// Integer keys (IDs, timestamps), enums and floats in their natural order: a pair
+/// of flag compares subtracted, no branches and no calls.
+template <typename KeyT, typename CompareT>
+struct KeyOrder<KeyT, CompareT,
+                typename std::enable_if<(std::is_arithmetic<KeyT>::value || std::is_enum<KeyT>::value) &&
+                                        isAscending<KeyT, CompareT>::value>::type>
+{
+    static int compare(const KeyT &lhs, const KeyT &rhs)
+    {
+        return (int)(rhs < lhs) - (int)(lhs < rhs);
+    }
+};
+
+template <typename KeyT, typename CompareT>
+struct KeyOrder<KeyT, CompareT,
+                typename std::enable_if<(std::is_arithmetic<KeyT>::value || std::is_enum<KeyT>::value) &&
+                                        isDescending<KeyT, CompareT>::value>::type>
+{
+    static int compare(const KeyT &lhs, const KeyT &rhs)
+    {
+        return (int)(lhs < rhs) - (int)(rhs < lhs);
+    }
+};
+
+/// Fixed width byte keys (hashes, UUIDs, packed composite keys): std::array's
+/// operator< is a byte at a time lexicographical compare, which for unsigned bytes
+/// is exactly what memcmp does, and memcmp with a constant length turns into a
+/// few word compares
+template <size_t width, typename CompareT>
+struct KeyOrder<std::array<unsigned char, width>, CompareT,
+                typename std::enable_if<isAscending<std::array<unsigned char, width>, CompareT>::value>::type>
+{
+    static int compare(const std::array<unsigned char, width> &lhs, const std::array<unsigned char, width> &rhs)
+    {
+        return memcmp(lhs.data(), rhs.data(), width);
+    }
+};
+
+/// How debug output (describeNode, via TreeMapNode::getCValue) prints a key of any
+/// type.  The general case is for keys that don't stream with <<: fixed width byte
+/// keys and other plain structs print as hex bytes, anything else as "?".
+template <typename KeyT, typename = void>
+struct KeyPrinter
+{
+    static void print(std::ostream &out, const KeyT &key)
+    {
+        static const char hexDigits[] = "0123456789abcdef";
+        
+        if (!std::is_trivially_copyable<KeyT>::value)
+        {
+            out << '?';
+            return;
+        }
+        
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&key);
+        
+        for (size_t i = 0 ; i < sizeof(KeyT) ; i++)
+            out << hexDigits[bytes[i] >> 4] << hexDigits[bytes[i] & 0xf];
+    }
+};
+
+/// Integers, enums and floats as numbers (a uint8_t or char key too, not as a character)
+template <typename KeyT>
+struct KeyPrinter<KeyT, typename std::enable_if<std::is_arithmetic<KeyT>::value || std::is_enum<KeyT>::value>::type>
+{
+    static void print(std::ostream &out, const KeyT &key)
+    {
+        if (std::is_floating_point<KeyT>::value)
+            out << (long double)key;
+        else if (std::is_signed<KeyT>::value || (std::is_enum<KeyT>::value && (long long)key < 0))
+            out << (long long)key;
+        else
+            out << (unsigned long long)key;
+    }
+};
+
+/// Keys that already stream (std::string and the like) the way they do
+template <typename KeyT>
+struct KeyPrinter<KeyT, typename std::enable_if<!std::is_arithmetic<KeyT>::value && !std::is_enum<KeyT>::value,
+                                                std::void_t<decltype(std::declval<std::ostream &>() << std::declval<const KeyT &>())> >::type>
+{
+    static void print(std::ostream &out, const KeyT &key)
+    {
+        out << key;
+    }
+};
+
+/// A key wrapped up so that << prints it through KeyPrinter
+template <typename KeyT>
+struct PrintableKey
+{
+    const KeyT &key;
+};
+
+template <typename KeyT>
+std::ostream &operator<<(std::ostream &out, PrintableKey<KeyT> printable)
+{
+    KeyPrinter<KeyT>::print(out, printable.key);
+    return out;
+}
+
+/// The node a TreeMap is built from.  Key and value sit right in the node, as a
+/// std::pair like std::map's, so there's no separate allocation for either of them
+/// and nothing for the tree to do node by node when it goes away if they're both
+/// trivially destructible.
+template <typename KeyT, typename ValueT, typename CompareT>
+class TreeMapNode : public TreeNode
+{
+public:
+    typedef std::pair<const KeyT, ValueT> value_type;
+    typedef ValueT mapped_type;
+    
+    /// Arena constructor, for BinaryTree::createNode.  Anything after the key goes
+    /// to ValueT's constructor.
+    template <typename... ValueArgs>
+    TreeMapNode(NodeArena &, const KeyT &key, ValueArgs&&... valueArgs) :
+    entry(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<ValueArgs>(valueArgs)...))
+    {
+        
+    }
+    
+    static const bool trivialArenaTeardown = std::is_trivially_destructible<KeyT>::value &&
+                                             std::is_trivially_destructible<ValueT>::value;
+    
+    /// Negative if rhs sorts before this node, positive if after, same as StringNode
+    int compare(const TreeMapNode *rhs) const
+    {
+        return KeyOrder<KeyT, CompareT>::compare(rhs->entry.first, entry.first);
+    }
+    
+    int compare(const TreeMapNode &rhs) const
+    {
+        return compare(&rhs);
+    }
+    
+    int compareKey(const KeyT &key) const
+    {
+        return KeyOrder<KeyT, CompareT>::compare(key, entry.first);
+    }
+    
+    const KeyT &getKey() const
+    {
+        return entry.first;
+    }
+    
+    /// For BinaryTree's debug output, which streams it through describeNode: the
+    /// key, printable whatever KeyT is
+    PrintableKey<KeyT> getCValue() const
+    {
+        return PrintableKey<KeyT>{entry.first};
+    }
+    
+    ValueT &getMapped()
+    {
+        return entry.second;
+    }
+    
+    const ValueT &getMapped() const
+    {
+        return entry.second;
+    }
+    
+    template <typename ArgT>
+    void setMapped(ArgT &&value)
+    {
+        entry.second = std::forward<ArgT>(value);
+    }
+    
+    value_type &getEntry()
+    {
+        return entry;
+    }
+    
+    const value_type &getEntry() const
+    {
+        return entry;
+    }
+
+private:
+    TreeMapNode &operator=(const TreeMapNode &) = delete;
+    
+    value_type entry;
+};
+
+/// An ordered map with value semantics, along the lines of std::map, on top of
+/// the same BinaryTree that StringNode trees use (red-black, unless BalancePolicyT
+/// says otherwise, e.g. AVLBalance for lookup heavy maps).  No node class to
+/// write: any key CompareT can order will do, e.g. TreeMap<uint64_t, Record> to
+/// index 64-bit IDs or timestamps.
+///
+/// Comparisons go through KeyOrder, which is picked at compile time and inlined
+/// into the tree's search loops; integer and fixed width byte keys get their own
+/// branch-free versions.  Nodes are allocated from the tree's NodeArena, in slabs,
+/// rather than one at a time from an allocator.
+///
+/// Copying a TreeMap copies its contents (in linear time, see buildFromSorted);
+/// moving one just hands over the tree, and never throws.  An empty map has no
+/// tree at all until something goes into it, so making, clearing or moving from a
+/// map allocates nothing.
+template <typename KeyT, typename ValueT, typename CompareT = std::less<KeyT>, typename BalancePolicyT = RedBlackBalance>
+class TreeMap
+{
+public:
+    typedef KeyT key_type;
+    typedef ValueT mapped_type;
+    typedef std::pair<const KeyT, ValueT> value_type;
+    typedef CompareT key_compare;
+    typedef size_t size_type;
+    typedef TreeMapNode<KeyT, ValueT, CompareT> node_type;
+    typedef BinaryTree<node_type, BalancePolicyT> tree_type;
+    
+    /// Iterators hand out the key/value pairs rather than the nodes holding them,
+    /// otherwise they're the tree's (bidirectional, end() can be decremented)
+    template <typename entryType, typename baseIterator>
+    class mapIterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef entryType value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef entryType *pointer;
+        typedef entryType &reference;
+        
+        mapIterator()
+        {
+            
+        }
+        
+        mapIterator(baseIterator it) : treeIt(it)
+        {
+            
+        }
+        
+        /// iterator converts to const_iterator, but not the other way around
+        template <typename otherEntry, typename otherBase>
+        mapIterator(const mapIterator<otherEntry, otherBase> &other) : treeIt(other.getTreeIterator())
+        {
+            
+        }
+        
+        reference operator*() const
+        {
+            return treeIt->getEntry();
+        }
+        
+        pointer operator->() const
+        {
+            return &treeIt->getEntry();
+        }
+        
+        mapIterator &operator++()
+        {
+            ++treeIt;
+            return *this;
+        }
+        
+        mapIterator operator++(int)
+        {
+            mapIterator before(*this);
+            ++treeIt;
+            return before;
+        }
+        
+        mapIterator &operator--()
+        {
+            --treeIt;
+            return *this;
+        }
+        
+        mapIterator operator--(int)
+        {
+            mapIterator before(*this);
+            --treeIt;
+            return before;
+        }
+        
+        bool operator==(const mapIterator &rhs) const
+        {
+            return treeIt == rhs.treeIt;
+        }
+        
+        bool operator!=(const mapIterator &rhs) const
+        {
+            return treeIt != rhs.treeIt;
+        }
+        
+        const baseIterator &getTreeIterator() const
+        {
+            return treeIt;
+        }
+    
+    private:
+        baseIterator treeIt;
+    };
+    
+    typedef mapIterator<value_type, typename tree_type::iterator> iterator;
+    typedef mapIterator<const value_type, typename tree_type::const_iterator> const_iterator;
+    
+    TreeMap()
+    {
+        
+    }
+    
+    TreeMap(std::initializer_list<value_type> entries) : TreeMap()
+    {
+        for (const value_type &entry : entries)
+            insert(entry);
+    }
+    
+    TreeMap(const TreeMap &other) : TreeMap()
+    {
+        copyFrom(other);
+    }
+    
+    TreeMap(TreeMap &&other) noexcept : tree(std::move(other.tree))
+    {
+        
+    }
+    
+    TreeMap &operator=(const TreeMap &other)
+    {
+        if (this != &other)
+        {
+            TreeMap copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+    
+    TreeMap &operator=(TreeMap &&other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+    
+    void swap(TreeMap &other) noexcept
+    {
+        tree.swap(other.tree);
+    }
+    
+    size_t size() const
+    {
+        return (tree ? tree->size() : 0);
+    }
+    
+    bool empty() const
+    {
+        return size() == 0;
+    }
+    
+    void clear()
+    {
+        tree.reset();
+    }
+    
+    iterator begin()
+    {
+        return (tree ? iterator(tree->begin()) : iterator());
+    }
+    
+    iterator end()
+    {
+        return (tree ? iterator(tree->end()) : iterator());
+    }
+    
+    const_iterator begin() const
+    {
+        return (tree ? const_iterator(static_cast<const tree_type &>(*tree).begin()) : const_iterator());
+    }
+    
+    const_iterator end() const
+    {
+        return (tree ? const_iterator(static_cast<const tree_type &>(*tree).end()) : const_iterator());
+    }
+    
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+    
+    const_iterator cend() const
+    {
+        return end();
+    }
+    
+    /// Add key with a value built from args, unless key is already there.  Returns
+    /// where key is, and whether it's new.
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const KeyT &key, Args&&... args)
+    {
+        std::pair<node_type *, bool> result = plantTree().try_emplace(key, std::forward<Args>(args)...);
+        return std::make_pair(iteratorFor(result.first), result.second);
+    }
+    
+    std::pair<iterator, bool> insert(const value_type &entry)
+    {
+        return try_emplace(entry.first, entry.second);
+    }
+    
+    template <typename ArgT>
+    std::pair<iterator, bool> insert_or_assign(const KeyT &key, ArgT &&value)
+    {
+        std::pair<node_type *, bool> result = plantTree().insert_or_assign(key, std::forward<ArgT>(value));
+        return std::make_pair(iteratorFor(result.first), result.second);
+    }
+    
+    /// The value for key, default constructing one if key isn't there yet
+    ValueT &operator[](const KeyT &key)
+    {
+        return plantTree().try_emplace(key).first->getMapped();
+    }
+    
+    /// The value for key, which has to be there (throws std::out_of_range if not)
+    ValueT &at(const KeyT &key)
+    {
+        node_type *node = (tree ? tree->find(key) : nullptr);
+        if (node == nullptr)
+            throw std::out_of_range("TreeMap::at");
+        return node->getMapped();
+    }
+    
+    const ValueT &at(const KeyT &key) const
+    {
+        const node_type *node = (tree ? static_cast<const tree_type &>(*tree).find(key) : nullptr);
+        if (node == nullptr)
+            throw std::out_of_range("TreeMap::at");
+        return node->getMapped();
+    }
+    
+    iterator find(const KeyT &key)
+    {
+        return (tree ? iteratorFor(tree->find(key)) : iterator());
+    }
+    
+    const_iterator find(const KeyT &key) const
+    {
+        if (!tree)
+            return const_iterator();
+        return const_iterator(typename tree_type::const_iterator(static_cast<const tree_type &>(*tree).find(key), tree.get()));
+    }
+    
+    bool contains(const KeyT &key) const
+    {
+        return tree && tree->contains(key);
+    }
+    
+    size_t count(const KeyT &key) const
+    {
+        return (contains(key) ? 1 : 0);
+    }
+    
+    iterator lower_bound(const KeyT &key)
+    {
+        return (tree ? iterator(tree->lower_bound(key)) : iterator());
+    }
+    
+    iterator upper_bound(const KeyT &key)
+    {
+        return (tree ? iterator(tree->upper_bound(key)) : iterator());
+    }
+    
+    const_iterator lower_bound(const KeyT &key) const
+    {
+        return (tree ? const_iterator(static_cast<const tree_type &>(*tree).lower_bound(key)) : const_iterator());
+    }
+    
+    const_iterator upper_bound(const KeyT &key) const
+    {
+        return (tree ? const_iterator(static_cast<const tree_type &>(*tree).upper_bound(key)) : const_iterator());
+    }
+    
+    std::pair<iterator, iterator> equal_range(const KeyT &key)
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+    
+    std::pair<const_iterator, const_iterator> equal_range(const KeyT &key) const
+    {
+        return std::make_pair(lower_bound(key), upper_bound(key));
+    }
+    
+    /// Remove key if it's there.  Returns the number of entries removed (0 or 1).
+    size_t erase(const KeyT &key)
+    {
+        return (tree ? tree->erase(key) : 0);
+    }
+    
+    /// Remove the entry at pos, returning the one after it
+    iterator erase(iterator pos)
+    {
+        typename tree_type::iterator doomed = pos.getTreeIterator();
+        typename tree_type::iterator next = doomed;
+        
+        ++next;
+        tree->erase(doomed.getNode());
+        return iterator(next);
+    }
+    
+    /// Order statistics, see BinaryTree::select and rank
+    iterator select(size_t k)
+    {
+        return (tree ? iteratorFor(tree->select(k)) : iterator());
+    }
+    
+    size_t rank(const KeyT &key) const
+    {
+        return (tree ? tree->rank(key) : 0);
+    }
+    
+    TreeStats stats() const
+    {
+        return (tree ? tree->stats() : tree_type().stats());
+    }
+    
+    /// See BinaryTree::setValidation.  Debug builds check the whole tree after every
+    /// change, which makes filling a big map quadratic; turn it down for that.  The
+    /// setting lasts until the map is cleared.
+    void setValidation(typename tree_type::ValidationLevel level, unsigned int interval = 1000)
+    {
+        plantTree().setValidation(level, interval);
+    }
+    
+    bool operator==(const TreeMap &rhs) const
+    {
+        return size() == rhs.size() && std::equal(begin(), end(), rhs.begin());
+    }
+    
+    bool operator!=(const TreeMap &rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+private:
+    /// The tree, made now if the map doesn't have one yet
+    tree_type &plantTree()
+    {
+        if (!tree)
+            tree.reset(new tree_type);
+        return *tree;
+    }
+    
+    iterator iteratorFor(node_type *node)
+    {
+        return iterator(typename tree_type::iterator(node, tree.get()));
+    }
+    
+    /// other is in order and has no duplicates, so its nodes can be copied and
+    /// linked up in one linear pass
+    void copyFrom(const TreeMap &other)
+    {
+        if (!other.tree)
+            return;
+        
+        tree_type &newTree = plantTree();
+        std::vector<node_type *> nodes;
+        
+        nodes.reserve(other.size());
+        for (const value_type &entry : other)
+            nodes.push_back(newTree.createNode(entry.first, entry.second));
+        
+        newTree.setValidation(other.tree->getValidationLevel());
+        newTree.buildFromSorted(nodes.begin(), nodes.end());
+    }
+    
+    std::unique_ptr<tree_type> tree;   // on the heap so moves and swaps are a pointer swap; null until something goes in, and after clear()
+};
+
+#endif /* defined(__Tree_exercises__TreeMap__) */
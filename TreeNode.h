@@ -10,6 +10,29 @@
 #define __Tree_exercises__TreeNode__
 #include <assert.h>
 
+class NodeArena;
+
+/// Keep a subtree size in every node, so BinaryTree can answer select/rank queries
+/// in O(log n).  Comment out to save the extra word per node and the upkeep on
+/// every insert and rotation (select/rank then fall back to walking the tree).
+#define SUBTREE_SIZES
+
+/// Store a child (or root) link that lock free readers may be following, see
+/// BinaryTree::Reader.  A release store, so a reader that gets to node through
+/// the link sees everything written to it before, i.e. its key and its links.
+template <typename NodeType>
+inline void publishLink(NodeType *&link, NodeType *node)
+{
+    __atomic_store_n(&link, node, __ATOMIC_RELEASE);
+}
+
+/// The reader's side of publishLink
+template <typename NodeType>
+inline NodeType *followLink(NodeType *const &link)
+{
+    return __atomic_load_n(&link, __ATOMIC_ACQUIRE);
+}
+
 /// Short hand for leftChild and rightChild enum values
 /// which have to be defined here, because they're used within the TreeNode
 /// class definition
@@ -28,16 +51,24 @@ public:
         
         rightNode = nullptr;
         nodeIsRed = false;
+        balanceInfo = 0;
         parentNode = nullptr;
         depth = 0;
+#ifdef SUBTREE_SIZES
+        subtreeSize = 1;
+#endif
     }
     
     TreeNode(const TreeNode &origNode) :
     leftNode(origNode.leftNode),
     rightNode(origNode.rightNode),
     nodeIsRed(origNode.nodeIsRed),
+    balanceInfo(origNode.balanceInfo),
     parentNode(origNode.parentNode),
     depth(origNode.depth)
+#ifdef SUBTREE_SIZES
+    , subtreeSize(origNode.subtreeSize)
+#endif
     {
         
     }
@@ -46,13 +77,32 @@ public:
     leftNode(origNode->leftNode),
     rightNode(origNode->rightNode),
     nodeIsRed(origNode->nodeIsRed),
+    balanceInfo(origNode->balanceInfo),
     parentNode(origNode->parentNode),
     depth(origNode->depth)
+#ifdef SUBTREE_SIZES
+    , subtreeSize(origNode->subtreeSize)
+#endif
     {
         
     }
-
-    virtual ~TreeNode()
+    
+    /// Not virtual: BinaryTree<NodeType> always destroys its nodes as NodeType,
+    /// so nodes don't need to carry a vtable pointer around
+    ~TreeNode()
+    {
+        
+    }
+    
+    /// Derived classes whose arena-built nodes own no other memory can set this
+    /// to true, letting BinaryTree drop them with the arena instead of destroying
+    /// them one at a time.  Be safe by default.
+    static const bool trivialArenaTeardown = false;
+    
+    /// Derived classes that copy their keys into the tree's arena give those bytes
+    /// back here, see StringNode.  BinaryTree calls it on an erased arena node, as
+    /// the node's own type, just before the node's slot goes on the free list.
+    void releaseArenaBytes(NodeArena &)
     {
         
     }
@@ -75,21 +125,23 @@ public:
     {
         assert(this->rightNode == nullptr);  // don't want to step on an existing pointer
         
-        // add it into the tree
-        this->rightNode = targetNode;
+        // add it into the tree (it's all set up, for any lock free reader that gets to it)
+        publishLink(this->rightNode, targetNode);
         this->rightNode->depth = this->depth + 1;
         targetNode->parentNode = this;
         targetNode->setToRed();
+        addToAncestorSizes(targetNode, 1);
     }
     
     void spliceNodeLeft(TreeNode *targetNode)
     {
         assert(this->leftNode == nullptr);  // don't want to step on an existing pointer
         
-        this->leftNode = targetNode;
+        publishLink(this->leftNode, targetNode);
         this->leftNode->depth = this->depth + 1;
         targetNode->parentNode = this;
         targetNode->setToRed();
+        addToAncestorSizes(targetNode, 1);
     }
     
     unsigned int getDepth() const
@@ -111,6 +163,40 @@ public:
         if (rightNode != nullptr) rightNode->fixDepths(thisDepth+1);
     }
     
+#ifdef SUBTREE_SIZES
+    /// Number of nodes in the subtree rooted at tn, zero for a null pointer
+    static unsigned int sizeOf(const TreeNode *tn)
+    {
+        return tn ? tn->subtreeSize : 0;
+    }
+    
+    unsigned int getSubtreeSize() const
+    {
+        return subtreeSize;
+    }
+    
+    void setSubtreeSize(unsigned int newSize)
+    {
+        subtreeSize = newSize;
+    }
+    
+    /// Recompute our size from our children, e.g. after a rotation moved them around
+    void recomputeSize()
+    {
+        subtreeSize = 1 + sizeOf(leftNode) + sizeOf(rightNode);
+    }
+#endif
+    
+    /// Adjust the sizes of every ancestor of node (not node itself) by delta.
+    /// Compiles away if we aren't keeping subtree sizes.
+    static void addToAncestorSizes(TreeNode *node, int delta)
+    {
+#ifdef SUBTREE_SIZES
+        for (TreeNode *up = node->parentNode ; up != nullptr ; up = up->parentNode)
+            up->subtreeSize += delta;
+#endif
+    }
+    
     // Some handy helper functions
     
     /// Check if a node is a leaf
@@ -174,6 +260,19 @@ public:
         else setToRed();
     }
     
+    /// Trade balancing state (color and balanceInfo) with another node, for when
+    /// one takes over the other's place in the tree
+    void swapBalance(TreeNode *other)
+    {
+        bool otherIsRed = other->nodeIsRed;
+        unsigned int otherInfo = other->balanceInfo;
+        
+        other->nodeIsRed = nodeIsRed;
+        other->balanceInfo = balanceInfo;
+        nodeIsRed = otherIsRed;
+        balanceInfo = otherInfo;
+    }
+    
     /// Find which child of the parent node we are
     NodeDirection getParentDir() const 
     {
@@ -185,25 +284,82 @@ public:
         else return (NONE);
     }
     
-    /// This method needs to be overloaded in a derived class to create an ordering
-    /// of data values in the nodes
-    virtual int compare(TreeNode &node)
+    /// Smallest and largest nodes in the subtree rooted here
+    TreeNode *leftMost()
+    {
+        TreeNode *node = this;
+        while (node->leftNode != nullptr) node = node->leftNode;
+        return node;
+    }
+    
+    TreeNode *rightMost()
     {
-        assert(false);  // don't call base class compare
-        return (0);
+        TreeNode *node = this;
+        while (node->rightNode != nullptr) node = node->rightNode;
+        return node;
+    }
+    
+    /// In-order successor and predecessor, found by following the parent links,
+    /// so no stack is needed.  Returns nullptr when we fall off either end of the tree.
+    TreeNode *nextNode()
+    {
+        if (rightNode != nullptr) return rightNode->leftMost();
+        
+        TreeNode *child = this;
+        TreeNode *up = parentNode;
+        while (up != nullptr && up->rightNode == child)
+        {
+            child = up;
+            up = up->parentNode;
+        }
+        return up;
+    }
+    
+    TreeNode *prevNode()
+    {
+        if (leftNode != nullptr) return leftNode->rightMost();
+        
+        TreeNode *child = this;
+        TreeNode *up = parentNode;
+        while (up != nullptr && up->leftNode == child)
+        {
+            child = up;
+            up = up->parentNode;
+        }
+        return up;
     }
     
     TreeNode *leftNode;
     TreeNode *rightNode;
     bool nodeIsRed;
+    unsigned int balanceInfo;   // the balance policy's word: AVL height, treap priority (fits in the padding)
     TreeNode *parentNode; // need this for rotation and balancing (like tires)
     
 private:
     unsigned int depth; /// \todo May not want to try to maintain depth, and just infer it on the fly if we need it
+#ifdef SUBTREE_SIZES
+    unsigned int subtreeSize;  /// this node plus everything below it
+#endif
     
     
 };
 
+/// Get from a TreeNode link to the node type it really is.  Everything linked into
+/// a BinaryTree<NodeType> is a NodeType, so this is a plain static_cast.  (There's
+/// no vtable to check it against: node types order themselves with a non-virtual
+/// compare() that BinaryTree calls directly, so it can be inlined.)
+template <typename NodeType>
+inline NodeType *nodeCast(TreeNode *node)
+{
+    return static_cast<NodeType *>(node);
+}
+
+template <typename NodeType>
+inline const NodeType *nodeCast(const TreeNode *node)
+{
+    return static_cast<const NodeType *>(node);
+}
+
 /// Here's the logical "NOT" for parity !LEFT = RIGHT and !RIGHT = LEFT
 /// Still, two wrongs don't make a RIGHT
 TreeNode::NodeDirection operator!(TreeNode::NodeDirection dir);
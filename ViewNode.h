@@ -0,0 +1,115 @@
+//
+//  ViewNode.h
+//  Tree exercises
+//
+//  Created by Eric on 10/17/26.
+//  Copyright (c) 2026 erflink. All rights reserved.
+//
+
+#ifndef __Tree_exercises__ViewNode__
+#define __Tree_exercises__ViewNode__
+
+#include <string_view>
+#include <cstring>
+
+#include "TreeNode.h"
+#include "NodeArena.h"
+#include "CaseFold.h"
+#include "StringNode.h"
+
+using namespace std;
+
+/// Node whose key is a view into memory someone else owns, typically a MappedFile
+/// holding the dictionary.  Nothing is copied: the node just points at the key's
+/// bytes, which have to stay put for as long as the node is in a tree.
+///
+/// Orders exactly like StringNode (ignoring case, abbreviated key first), and
+/// takes the same lookup keys.  There's no folded copy of the key to compare
+/// against, since that would be a copy; ties on the first 8 bytes fold as they go.
+class ViewNode :  public TreeNode
+{
+public:
+    typedef StringNode::Probe Probe;
+    
+    ViewNode(string_view value) :
+    keyData(value.data()),
+    keyLength(value.length()),
+    abbrevKey(foldedPrefix(value.data(), value.length()))
+    {
+        
+    }
+    
+    /// What BinaryTree::createNode calls.  The arena only holds the node itself.
+    ViewNode(NodeArena &, string_view value) : ViewNode(value)
+    {
+        
+    }
+    
+    /// A ViewNode owns nothing, so a tree can drop its arena nodes in bulk
+    static const bool trivialArenaTeardown = true;
+    
+    int compare(const ViewNode &rhs) const
+    {
+        return compare(&rhs);
+    }
+    
+    /// Negative if rhs sorts before this node, positive if after
+    int compare(const ViewNode *rhs) const
+    {
+        if (rhs->abbrevKey != abbrevKey)
+            return (rhs->abbrevKey < abbrevKey ? -1 : 1);
+        
+        return foldCompare(rhs->keyData, rhs->keyLength, keyData, keyLength);
+    }
+    
+    /// Compare a bare key against this node, same sign convention as compare()
+    int compareKey(const Probe &key) const
+    {
+        if (key.abbrevKey != abbrevKey)
+            return (key.abbrevKey < abbrevKey ? -1 : 1);
+        
+        return foldCompare(key.keyData, key.keyLength, keyData, keyLength);
+    }
+    
+    int compareKey(string_view key) const
+    {
+        return compareKey(Probe(key));
+    }
+    
+    int compareKey(const char *key) const
+    {
+        return compareKey(Probe(key));
+    }
+    
+    int compareKey(const string &key) const
+    {
+        return compareKey(Probe(key));
+    }
+    
+    /// The key isn't NUL terminated (in a mapped dictionary it runs up to a newline),
+    /// so it comes back as a view.  Debug output goes through describeNode
+    /// (debugprintf.h), which streams it with <<.
+    string_view getCValue() const
+    {
+        return string_view(keyData, keyLength);
+    }
+    
+    size_t getLength() const
+    {
+        return keyLength;
+    }
+    
+    uint64_t getAbbrevKey() const
+    {
+        return abbrevKey;
+    }
+    
+private:
+    ViewNode &operator=(const ViewNode &) = delete;
+    
+    const char *keyData;    // not ours
+    size_t keyLength;
+    uint64_t abbrevKey;     // first 8 bytes of the key folded, see StringNode
+};
+
+#endif /* defined(__Tree_exercises__ViewNode__) */
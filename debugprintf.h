@@ -10,6 +10,9 @@
 #define Tree_exercises_debugprintf_h
 // #define DEBUG_OUTPUT
 
+#include <sstream>
+#include <string>
+
 #ifdef DEBUG_OUTPUT
 #define debugPrintf(x) printf(x)
 #define debugPrintf1(x, y) printf(x, y)
@@ -24,4 +27,20 @@
 #define debugPrintf4(x, y, z, xx, yy)
 #endif
 
+/// A node's value as text for debug output, or "NULL" for no node.  It streams
+/// whatever getCValue() gives back with <<, so keys that aren't NUL terminated C
+/// strings (a ViewNode's string_view) print as they are.  Pass it to a %s as
+/// describeNode(node).c_str(), never getCValue() itself.
+template <typename NodeT>
+std::string describeNode(const NodeT *node)
+{
+    if (node == nullptr)
+        return "NULL";
+    
+    std::ostringstream text;
+    
+    text << node->getCValue();
+    return text.str();
+}
+
 #endif
@@ -46,7 +46,7 @@ void Visualize::buildGraph(Agraph_t *theGraph, TreeNode const *theNode)
         return;
     
     // Add this node to the graph
-    StringNode const *strNode = dynamic_cast<StringNode const *>(theNode);
+    StringNode const *strNode = nodeCast<StringNode>(theNode);
     
     debugPrintf3("buildGraph for node %p(%s)... parent %p\n", (void *)theNode, strNode->getCValue(), strNode->parentNode);
     
@@ -66,7 +66,7 @@ void Visualize::buildGraph(Agraph_t *theGraph, TreeNode const *theNode)
     // Now add an edge to its parent node
     if (theNode->parentNode != nullptr)
     {
-        StringNode *parNode = dynamic_cast<StringNode *>(theNode->parentNode);
+        StringNode *parNode = nodeCast<StringNode>(theNode->parentNode);
         
         Agnode_t *parentNode = agnode(theGraph, (char *)(parNode->getCValue()), true);
         